@@ -0,0 +1,354 @@
+
+/*
+	Benchmark of the syntax highlighter alone, without markdown parsing and file saving
+	Usage: highlighting_bench [litedocs repository dir] [--update-hashes]
+
+	For every language in langs/ highlights the corpora from bench/corpora/<language>/
+	and generated cases (multi-megabyte input, unterminated pairs, long tokens, dense breaks)
+	Hashes of the produced html are compared with bench/corpora/expected_hashes.txt,
+	so optimizations can't silently change the output
+*/
+
+#define LITEDOCS_IMPLEMENTATION
+#define MARKDOWN_PARSER_IMPLEMENTATION
+#define LITEDOCS_HIGHLIGHTING_PROFILE
+
+//https://github.com/nlohmann/json
+#include "../include/nlohmann/json.hpp"
+
+//https://github.com/TakiKacper/MarkdownParser
+#include "../include/markdown_parser.hpp"
+
+#include "../litedocs/litedocs.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <atomic>
+#include <map>
+#include <new>
+#include <cstdlib>
+
+/*
+	Allocation counting
+*/
+
+std::atomic<size_t> allocations_count{ 0 };
+
+void* operator new(size_t size)
+{
+	allocations_count++;
+	if (void* ptr = std::malloc(size == 0 ? 1 : size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+/*
+	Cases
+*/
+
+struct bench_case
+{
+	std::string language;
+	std::string name;
+	std::string source;
+};
+
+struct bench_result
+{
+	double mb_per_second = 0;
+	double allocations_per_kb = 0;
+	litedocs_internal::highlighting_profile profile;
+	std::string hash;
+};
+
+std::string read_whole_file(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+std::string fnv1a_hash(const std::string& text)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	for (unsigned char c : text)
+	{
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+
+	std::stringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return ss.str();
+}
+
+std::string repeat_to_size(const std::string& pattern, size_t size)
+{
+	std::string result;
+	result.reserve(size + pattern.size());
+	while (result.size() < size)
+		result += pattern;
+	return result;
+}
+
+void add_generated_cases(std::vector<bench_case>& cases, const std::string& language, const litedocs_internal::highlighting_rules* rules, const std::string& largest_corpus)
+{
+	constexpr size_t megabyte = 1024 * 1024;
+
+	if (!largest_corpus.empty())
+		cases.push_back({ language, "generated_4mb", repeat_to_size(largest_corpus, 4 * megabyte) });
+
+	//Pairs that are never closed, so the rest of the block is scanned for the end token
+	for (auto* rule : rules->rules)
+	{
+		auto as_pairs_rule = dynamic_cast<const litedocs_internal::highlighting_rules::pairs_rule*>(rule);
+		if (as_pairs_rule == nullptr) continue;
+
+		std::string filler = repeat_to_size("lorem ipsum ", megabyte);
+		size_t found;
+		while ((found = filler.find(as_pairs_rule->end)) != std::string::npos)
+			filler.erase(found, as_pairs_rule->end.size());
+
+		cases.push_back({ language, "adversarial_unterminated_pairs", as_pairs_rule->begin + filler });
+		break;
+	}
+
+	//One huge token without any break
+	cases.push_back({ language, "adversarial_long_token", std::string(256 * 1024, 'a') });
+
+	//Nothing but breaks, every token is a delimiter
+	std::string all_breaks;
+	for (auto& _break : rules->breaks)
+		all_breaks += _break;
+	if (!all_breaks.empty())
+		cases.push_back({ language, "adversarial_dense_breaks", repeat_to_size(all_breaks, megabyte) });
+}
+
+bench_result run_case(litedocs_internal::generator_state& generator, const bench_case& c)
+{
+	using clock = std::chrono::steady_clock;
+	bench_result result;
+
+	//Warm up, count allocations and collect the output hash
+	size_t allocations_before = allocations_count;
+	std::string output = litedocs_internal::highlight_code(generator, c.language, c.source, 0, c.source.size());
+	size_t allocations = allocations_count - allocations_before;
+
+	result.hash = fnv1a_hash(output);
+	result.allocations_per_kb = c.source.empty() ? 0 : allocations / (c.source.size() / 1024.0);
+
+	//Throughput, without the profiling timers
+	size_t iterations = 0;
+	auto begin = clock::now();
+	auto elapsed = clock::duration::zero();
+
+	while (iterations < 3 || elapsed < std::chrono::milliseconds(250))
+	{
+		auto out = litedocs_internal::highlight_code(generator, c.language, c.source, 0, c.source.size());
+		iterations++;
+		elapsed = clock::now() - begin;
+	}
+
+	double seconds = std::chrono::duration<double>(elapsed).count();
+	result.mb_per_second = (c.source.size() * iterations) / (1024.0 * 1024.0) / seconds;
+
+	//Time spent in each rule type
+	litedocs_internal::active_highlighting_profile = &result.profile;
+	litedocs_internal::highlight_code(generator, c.language, c.source, 0, c.source.size());
+	litedocs_internal::active_highlighting_profile = nullptr;
+
+	return result;
+}
+
+//Escaping code compared with a plain copy of the same bytes
+void run_escaping_bench(const std::string& source)
+{
+	using clock = std::chrono::steady_clock;
+
+	auto throughput = [&](auto function)
+	{
+		size_t iterations = 0;
+		auto begin = clock::now();
+		auto elapsed = clock::duration::zero();
+
+		while (iterations < 3 || elapsed < std::chrono::milliseconds(250))
+		{
+			function();
+			iterations++;
+			elapsed = clock::now() - begin;
+		}
+
+		return (source.size() * iterations) / (1024.0 * 1024.0) / std::chrono::duration<double>(elapsed).count();
+	};
+
+	std::string out;
+	out.reserve(source.size() * 5);
+
+	double escaping = throughput([&]() { out.clear(); litedocs_internal::append_html_escaped(out, source); });
+	double copying = throughput([&]() { out.clear(); out.append(source); });
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< "\nhtml escaping of " << source.size() / 1024.0 << " KB: " << escaping << " MB/s, plain copy: " << copying << " MB/s\n";
+}
+
+int main(int argc, char* argv[])
+{
+	std::filesystem::path repository = ".";
+	bool update_hashes = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--update-hashes") update_hashes = true;
+		else repository = arg;
+	}
+
+	auto langs_dir = repository / "langs";
+	auto corpora_dir = repository / "bench" / "corpora";
+	auto hashes_path = corpora_dir / "expected_hashes.txt";
+
+	if (!std::filesystem::is_directory(langs_dir))
+	{
+		std::cout << "[Error] Missing langs directory: " << langs_dir.string() << '\n';
+		return 1;
+	}
+
+	/*
+		Load rules and cases
+	*/
+
+	litedocs::generator_settings settings;
+	settings.threads = 1;
+	settings.langs_directory = langs_dir.string();
+	settings.highlighting_cache_bytes = 0;
+
+	//Adversarial cases would be cut short, the bench measures the whole highlighter
+	settings.highlighting_time_budget_ms = 0;
+	settings.highlighting_work_budget = 0;
+
+	litedocs_internal::generator_state generator(settings);
+
+	std::vector<bench_case> cases;
+
+	std::vector<std::filesystem::path> rule_files;
+	for (auto& entry : std::filesystem::directory_iterator(langs_dir))
+		if (entry.path().extension() == ".json")
+			rule_files.push_back(entry.path());
+	std::sort(rule_files.begin(), rule_files.end());
+
+	for (auto& rule_file : rule_files)
+	{
+		std::string language = rule_file.stem().string();
+
+		auto rules = litedocs_internal::load_highlighting_rules_from_file(rule_file, language);
+		if (rules == nullptr)
+		{
+			std::cout << "[Error] Failed to load rules: " << rule_file.string() << '\n';
+			return 1;
+		}
+		generator.highlighted_languages.insert({ language, rules });
+
+		std::string largest_corpus;
+
+		std::vector<std::filesystem::path> corpora;
+		if (std::filesystem::is_directory(corpora_dir / language))
+			for (auto& entry : std::filesystem::directory_iterator(corpora_dir / language))
+				corpora.push_back(entry.path());
+		std::sort(corpora.begin(), corpora.end());
+
+		for (auto& corpus : corpora)
+		{
+			cases.push_back({ language, corpus.filename().string(), read_whole_file(corpus) });
+			if (cases.back().source.size() > largest_corpus.size())
+				largest_corpus = cases.back().source;
+		}
+
+		add_generated_cases(cases, language, rules, largest_corpus);
+	}
+
+	std::map<std::string, std::string> expected_hashes;
+	{
+		std::ifstream hashes(hashes_path);
+		std::string language, name, hash;
+		while (hashes >> language >> name >> hash)
+			expected_hashes[language + " " + name] = hash;
+	}
+
+	/*
+		Run
+	*/
+
+	std::cout << std::left
+		<< std::setw(8) << "lang" << std::setw(34) << "case" << std::right
+		<< std::setw(10) << "KB" << std::setw(10) << "MB/s" << std::setw(11) << "allocs/KB"
+		<< std::setw(10) << "tokens%" << std::setw(10) << "keyw%" << std::setw(10) << "pairs%" << std::setw(10) << "regex%"
+		<< "  hash\n";
+
+	bool hashes_match = true;
+	std::stringstream new_hashes;
+
+	for (auto& c : cases)
+	{
+		auto result = run_case(generator, c);
+
+		auto& p = result.profile;
+		double total = static_cast<double>(p.tokenizing + p.keywords_rules + p.pairs_rules + p.regex_rules);
+		auto percent = [&](long long part) { return total == 0 ? 0.0 : 100.0 * part / total; };
+
+		std::string key = c.language + " " + c.name;
+		std::string verdict;
+
+		auto expected = expected_hashes.find(key);
+		if (expected == expected_hashes.end())
+			verdict = "(new)";
+		else if (expected->second != result.hash)
+		{
+			verdict = "MISMATCH, expected " + expected->second;
+			hashes_match = false;
+		}
+
+		new_hashes << key << " " << result.hash << '\n';
+
+		std::cout << std::left << std::fixed << std::setprecision(1)
+			<< std::setw(8) << c.language << std::setw(34) << c.name << std::right
+			<< std::setw(10) << c.source.size() / 1024.0
+			<< std::setw(10) << result.mb_per_second
+			<< std::setw(11) << std::setprecision(2) << result.allocations_per_kb << std::setprecision(1)
+			<< std::setw(10) << percent(p.tokenizing)
+			<< std::setw(10) << percent(p.keywords_rules)
+			<< std::setw(10) << percent(p.pairs_rules)
+			<< std::setw(10) << percent(p.regex_rules)
+			<< "  " << result.hash << " " << verdict << '\n';
+	}
+
+	//Code heavy input, with templates and comparisons on every line, prose with few special characters and prose without any
+	run_escaping_bench(repeat_to_size("std::vector<std::pair<int, float>> values; if (a < b && c > d) { return x; }\n                const auto& value = values.at(index).second;\n", 8 * 1024 * 1024));
+	run_escaping_bench(repeat_to_size("The quick brown fox jumps over the lazy dog, then returns the value of the call to the caller. a < b\n", 8 * 1024 * 1024));
+	run_escaping_bench(repeat_to_size("The quick brown fox jumps over the lazy dog, then returns the value of the call to the caller.\n", 8 * 1024 * 1024));
+
+	if (update_hashes)
+	{
+		std::ofstream(hashes_path) << new_hashes.str();
+		std::cout << "\n[Saved] " << hashes_path.string() << '\n';
+		return 0;
+	}
+
+	if (!hashes_match)
+	{
+		std::cout << "\n[Error] Highlighted output changed, rerun with --update-hashes if that is intended\n";
+		return 1;
+	}
+
+	return 0;
+}
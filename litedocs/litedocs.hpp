@@ -1,10 +1,22 @@
 #pragma once
 #include <string>
 #include <list>
+#include <vector>
+#include <ostream>
+#include <istream>
+#include <functional>
 
 //Define LITEDOCS_IMPLEMENTATION to implementation litedocs in given compilation unit
 //Also include nlohmann/json.hpp" and "markdown_parser.hpp"
 
+namespace litedocs_internal
+{
+	struct generator_state;
+	struct archive_writer_state;
+	struct archive_reader_state;
+	struct project_job;
+}
+
 namespace litedocs
 {
 	struct loaded_file
@@ -15,9 +27,12 @@ namespace litedocs
 
 	struct generated_page
 	{
-		//Page name (without .html extension)
+		//Page name (without extension)
 		std::string								page_name;
 
+		//Extension to append to the page name when saving
+		std::string								extension = ".html";
+
 		//Sections to which given page belongs
 		//The vector under the pointer may be changed during parsing other pages
 		//So save the file immediately or copy the vector
@@ -25,18 +40,251 @@ namespace litedocs
 
 		//Generated page content in html
 		const std::string*						content = nullptr;
+
+		//Set instead of content for pages streamed block by block (see streaming_threshold)
+		//Writes the whole page to the stream, call it once, before returning from the save callback
+		std::function<void(std::ostream&)>		write_content;
+
+		//Snippet files the page includes, relative to the project folder; nullptr for files other than pages
+		//A page has to be generated again when one of them changes
+		const std::vector<std::string>*			includes = nullptr;
+	};
+
+	struct staged_asset
+	{
+		//Asset file, relative to the project folder
+		std::string								source;
+
+		//Where the pages expect the file, relative to the build folder
+		//Every destination has the same content, so copy once and link the rest
+		std::vector<std::string>				destinations;
+
+		//Hash of the file content (16 hex digits)
+		std::string								content_hash;
+		size_t									size = 0;
 	};
 
 	using save_page_callback = void(*)(generated_page* page, const std::string& project_path);
 	using load_file_callback = loaded_file(*)(std::string filename, const std::string& project_path);
 	using message_callback = void(*)(const std::string& message);
+	using save_asset_callback = void(*)(const staged_asset* asset, const std::string& project_path);
+
+	struct generator_settings
+	{
+		//Threads rendering the pages, 0 uses all hardware threads
+		size_t			threads = 0;
+
+		//Folder with the highlighting rules, empty uses "langs" next to the executable
+		std::string		langs_directory;
+
+		//Highlighted code blocks are reused between pages and calls up to this many bytes, 0 disables the cache
+		size_t			highlighting_cache_bytes = 64 * 1024 * 1024;
+
+		//Threads loading the page files, while the others render
+		size_t			io_threads = 1;
 
+		//Pages loaded but not saved yet, bounds the memory; 0 uses 2 * threads + io_threads
+		size_t			pages_in_flight = 0;
+
+		//Save pages in the pages_order order, otherwise as soon as they are rendered
+		bool			ordered_output = false;
+
+		//Code blocks taking longer to highlight are left unhighlighted, with a warning; 0 disables
+		size_t			highlighting_time_budget_ms = 5000;
+
+		//The same for the work of the highlighter, in characters examined per byte of the code block; 0 disables
+		size_t			highlighting_work_budget = 256;
+
+		//Tokens longer than this are left unhighlighted by regex rules, whose matching can't be stopped by the budgets; 0 disables
+		size_t			highlighting_regex_token_limit = 1024;
+
+		//Converted snippets are reused between pages and calls up to this many bytes of their html
+		size_t			snippet_cache_bytes = 16 * 1024 * 1024;
+	};
+
+	//Project kept loaded to render its pages one at a time, see generator::load_project
+	struct loaded_project
+	{
+		loaded_project() = default;
+		~loaded_project();
+
+		loaded_project(const loaded_project&) = delete;
+		loaded_project& operator=(const loaded_project&) = delete;
+
+		litedocs_internal::project_job* job = nullptr;
+	};
+
+	//Owns the loaded highlighting rules, caches, threads and buffers used for generation
+	//Keep it alive between calls to reuse them; generate may be called from many threads at once
+	//Pages are loaded on the io threads and saved on a writer thread while others render, even with 1 thread
+	//So load_file, save_page and message may be called at the same time from different threads and must be thread safe
+	//save_asset is called from the thread calling generate, after all pages are saved
+	struct generator
+	{
+		generator(const generator_settings& settings = {});
+		~generator();
+
+		generator(const generator&) = delete;
+		generator& operator=(const generator&) = delete;
+
+		//If save_asset is not nullptr, local files referenced from the pages are staged through it after all pages are saved
+		bool generate(
+			const std::string& project_file_filepath,
+			load_file_callback load_file,
+			save_page_callback save_file,
+			message_callback message,
+			save_asset_callback save_asset = nullptr
+		);
+
+		//Generates many projects at once, pages of all projects are rendered on the same threads
+		//Returns false if any project failed
+		//succeeded	: if not nullptr, gets whether each project succeeded, in the order of the project files
+		bool generate_batch(
+			const std::vector<std::string>& project_files_filepaths,
+			load_file_callback load_file,
+			save_page_callback save_file,
+			message_callback message,
+			save_asset_callback save_asset = nullptr,
+			std::vector<bool>* succeeded = nullptr
+		);
+
+		//Renders shard_index of shard_count shares of the project's pages, for builds split across processes
+		//Pages are shared out by the size of their files, the same sources give the same shares
+		//Only the pages are saved, shard_manifest gets what merge_shards needs to save the rest
+		bool generate_shard(
+			const std::string& project_file_filepath,
+			size_t shard_index,
+			size_t shard_count,
+			load_file_callback load_file,
+			save_page_callback save_file,
+			message_callback message,
+			std::string& shard_manifest
+		);
+
+		//Saves what the shards left out, like generate does after the pages: assets, highlighting.css and the offline files
+		//Pages saved by the shards have to be in place already; fails unless every page is in exactly one manifest
+		//load_saved_page	: if not nullptr, loads the merged pages by their names in the build folder, with / between the sections,
+		//					  and the merge fails unless they have the hashes the shards wrote to their manifests
+		bool merge_shards(
+			const std::string& project_file_filepath,
+			const std::vector<std::string>& shard_manifests,
+			load_file_callback load_file,
+			save_page_callback save_file,
+			message_callback message,
+			save_asset_callback save_asset = nullptr,
+			load_file_callback load_saved_page = nullptr
+		);
+
+		//Loads the project and generates its head, navbar and sidebar once, for render_page
+		//The callbacks are kept in the project and called by render_page
+		bool load_project(
+			const std::string& project_file_filepath,
+			load_file_callback load_file,
+			message_callback message,
+			loaded_project& project
+		);
+
+		//Renders one page of a loaded project to html, for previews while editing it; nothing is saved
+		//page_file		: as in pages_order
+		//markdown		: rendered instead of the file's content if not nullptr, like unsaved text in an editor
+		//				  the page doesn't have to be in pages_order then
+		//stylesheet	: if not nullptr, gets the colors of the page's code blocks, which builds save to highlighting.css
+		//The page is never streamed nor split, and included snippets are read again; may be called from many threads
+		bool render_page(
+			loaded_project& project,
+			const std::string& page_file,
+			std::string& html,
+			const std::string* markdown = nullptr,
+			std::string* stylesheet = nullptr
+		);
+
+		//Directory listings of "dir" entries in pages order, reused while directories don't change
+		//Save them after generating and load them before the next run, to skip reading unchanged directories
+		void save_directory_cache(std::ostream& out);
+		void load_directory_cache(std::istream& in);
+
+		//Hashes of the assets with their sizes and modification times, unchanged assets aren't read again
+		void save_asset_cache(std::ostream& out);
+		void load_asset_cache(std::istream& in);
+
+		litedocs_internal::generator_state* state = nullptr;
+	};
+
+	//Generates with a temporary generator rendering on one thread
+	//Pages are still loaded and saved on threads of their own, so load_file, save_page and message must be thread safe
 	bool generate_docs(
 		const std::string& project_file_filepath, 
 		load_file_callback load_file,
 		save_page_callback save_file,
-		message_callback message
+		message_callback message,
+		save_asset_callback save_asset = nullptr
 	);
+
+	//Generates with a temporary generator, threads = 0 uses all hardware threads
+	bool generate_docs_batch(
+		const std::vector<std::string>& project_files_filepaths,
+		load_file_callback load_file,
+		save_page_callback save_file,
+		message_callback message,
+		save_asset_callback save_asset = nullptr,
+		size_t threads = 0
+	);
+
+	//Tar archive to save a whole build into, instead of a file per page
+	//Files are written as they are added, from any thread; with ordered_output the archive is the same on every run
+	struct archive_writer
+	{
+		archive_writer() = default;
+		~archive_writer();
+
+		archive_writer(const archive_writer&) = delete;
+		archive_writer& operator=(const archive_writer&) = delete;
+
+		bool open(const std::string& path);
+
+		//Names are relative to the archive root, with / between directories
+		bool add_file(const std::string& name, const std::string& content);
+
+		//For streamed pages and files copied from the disk, the size is filled in after writing
+		bool add_file(const std::string& name, const std::function<void(std::ostream&)>& write_content);
+
+		//Entry with the content of an earlier one, without storing it again
+		bool add_link(const std::string& name, const std::string& target);
+
+		//Ends the archive; with write_index saves [path].index too, so archive_reader doesn't have to walk the archive
+		bool close(bool write_index = false);
+
+		litedocs_internal::archive_writer_state* state = nullptr;
+	};
+
+	//Serves files straight from an archive, which is memory mapped instead of unpacked
+	struct archive_reader
+	{
+		archive_reader() = default;
+		~archive_reader();
+
+		archive_reader(const archive_reader&) = delete;
+		archive_reader& operator=(const archive_reader&) = delete;
+
+		//Uses [path].index if it belongs to this archive, otherwise reads the headers
+		bool open(const std::string& path);
+		void close();
+
+		//Points into the mapped archive, valid until close; nullptr if there is no such file
+		const char* find(const std::string& name, size_t& size) const;
+
+		std::vector<std::string> names() const;
+
+		litedocs_internal::archive_reader_state* state = nullptr;
+	};
+
+#ifdef LITEDOCS_ALLOCATION_PROFILE
+	//Table of allocations of every page and stage, sort_by is one of: bytes, count, peak, page, stage
+	void write_allocation_report(std::ostream& out, const std::string& sort_by = "bytes");
+
+	//The same numbers, as json for tracking over time
+	void write_allocation_report_json(std::ostream& out);
+#endif
 }
 
 #ifdef LITEDOCS_IMPLEMENTATION
@@ -49,159 +297,607 @@ namespace litedocs
 #include <unordered_set>
 #include <fstream>
 #include <regex>
+#include <chrono>
+#include <map>
+#include <set>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
 
 #include "source/utility.hpp"
+#include "source/allocation_profile.hpp"
 #include "source/project.hpp"
 
-//Define global html tags to use when parsing mardkown
+#include "source/workers.hpp"
+
+//State shared by all generations of one generator
 namespace litedocs_internal
 {
-	std::string higlight_syntax(const std::string&, const std::string&, size_t, size_t);
+	struct highlighting_rules;
 
-	markdown_parsing::html_tags html_tags_override {};
-	struct initialize_html_tags
+	//Highlighted code blocks, shared by all pages and projects
+	struct highlighting_cache
 	{
-		initialize_html_tags()
-		{
-			html_tags_override.syntax_highlighting = higlight_syntax;
-			html_tags_override.code_block_tags = { " <div class=\"code_border\"><pre><code>", "</code></pre></div>" };
-		}
+		std::mutex mutex;
+		size_t bytes = 0;
+
+		//key	: language name, new line, code
+		//value : highlighted code
+		std::unordered_map<std::string, std::string> blocks;
 	};
-	initialize_html_tags  _initialize_html_tags{};
-}
 
-//Global cache of syntax highlighting rules
-namespace litedocs_internal
-{
-	struct highlighting_rules;
+	//Markdown included into pages, converted once and shared by every page including it
+	struct snippet
+	{
+		std::once_flag converted;
+
+		//Markdown until converted, then html
+		std::string markdown;
+		std::string html;
+
+		//Key in the snippet cache
+		std::string hash;
+
+		//Languages of the code blocks in the snippet
+		std::set<std::string> languages;
+	};
 
-	//key	: language name
-	//value : rules object (may be nullptr, if failed to load)
-	std::unordered_map<std::string, highlighting_rules*> highlighted_languages;
-	struct highlighted_languages_destructor
-	{~highlighted_languages_destructor();};
+	//Snippets, shared by all pages and projects
+	struct snippet_cache
+	{
+		std::mutex mutex;
+
+		//Of the markdown of snippets not converted yet and the html of the converted ones
+		size_t bytes = 0;
+
+		//key	: content hash of the markdown
+		std::unordered_map<std::string, std::shared_ptr<snippet>> snippets;
+	};
+
+	//Entries of one directory, as last read from the disk
+	struct directory_listing
+	{
+		long long modification_time = 0;
+		std::vector<std::string> files;
+		std::vector<std::string> directories;
+	};
+
+	//Listings of directories scanned for "dir" entries of pages order
+	//Reused while the directory's modification time is the same, which changes when entries are added or removed
+	struct directory_cache
+	{
+		std::mutex mutex;
+
+		//key	: directory path
+		std::map<std::string, directory_listing> listings;
+	};
+
+	//Content hash of an asset file, with the size and modification time it had when hashed
+	struct asset_hash
+	{
+		size_t size = 0;
+		long long modification_time = 0;
+		std::string hash;
+	};
+
+	//Hashes of asset files, reused while their size and modification time are the same
+	struct asset_hash_cache
+	{
+		std::mutex mutex;
+
+		//key	: file path
+		std::map<std::string, asset_hash> hashes;
+	};
+
+	struct generator_state
+	{
+		litedocs::generator_settings settings;
+
+		//Html tags to use when parsing markdown
+		markdown_parsing::html_tags html_tags;
+
+		//key	: language name
+		//value : rules object (may be nullptr, if failed to load)
+		std::unordered_map<std::string, highlighting_rules*> highlighted_languages;
+		std::mutex highlighted_languages_mutex;
+
+		highlighting_cache cache;
+		directory_cache directories;
+		asset_hash_cache asset_hashes;
+		snippet_cache snippets;
+
+		worker_pool pool;
+
+		//Buffers for assembling pages, kept to avoid reallocating them for every page
+		std::vector<std::unique_ptr<std::string>> page_buffers;
+		std::mutex page_buffers_mutex;
+
+		generator_state(const litedocs::generator_settings& _settings);
+		~generator_state();
+
+		std::unique_ptr<std::string> take_page_buffer();
+		void return_page_buffer(std::unique_ptr<std::string> buffer);
+	};
+
+	//Code block left as a placeholder in the markdown output, highlighted later on the worker pool
+	struct deferred_highlight
+	{
+		std::string language;
+		std::string code;
+		std::string html;
+		bool over_budget = false;
+	};
+
+	//What the current thread is rendering, for the syntax highlighting callback
+	struct render_context
+	{
+		generator_state* generator = nullptr;
+
+		//Languages of the code blocks in the page
+		std::set<std::string>* used_languages = nullptr;
+
+		//If not nullptr, code blocks are collected here instead of highlighted
+		std::vector<deferred_highlight>* deferred = nullptr;
+
+		//For warnings about code blocks
+		const std::string* page = nullptr;
+		litedocs::message_callback message = nullptr;
+	};
+
+	thread_local render_context current_render_context;
 }
 
+#include "source/html_escape.hpp"
 #include "source/syntax_highlighting.hpp"
 
-litedocs_internal::highlighted_languages_destructor::~highlighted_languages_destructor()
+litedocs_internal::generator_state::generator_state(const litedocs::generator_settings& _settings)
+	: settings(_settings), pool(_settings.threads)
+{
+	html_tags.syntax_highlighting = higlight_syntax;
+	html_tags.code_block_tags = { " <div class=\"code_border\"><pre><code>", "</code></pre></div>" };
+
+	if (settings.langs_directory.empty())
+		settings.langs_directory = get_executable_dir() + "/langs";
+}
+
+litedocs_internal::generator_state::~generator_state()
 {
 	for (auto& x : highlighted_languages)
 		delete x.second;
 }
 
+std::unique_ptr<std::string> litedocs_internal::generator_state::take_page_buffer()
+{
+	std::lock_guard<std::mutex> lock(page_buffers_mutex);
+
+	if (page_buffers.empty())
+		return std::make_unique<std::string>();
+
+	auto buffer = std::move(page_buffers.back());
+	page_buffers.pop_back();
+	return buffer;
+}
+
+void litedocs_internal::generator_state::return_page_buffer(std::unique_ptr<std::string> buffer)
+{
+	//Don't hold on to the memory of exceptionally big pages
+	constexpr size_t max_kept_capacity = 16 * 1024 * 1024;
+	if (buffer->capacity() > max_kept_capacity) return;
+
+	buffer->clear();
+
+	std::lock_guard<std::mutex> lock(page_buffers_mutex);
+	if (page_buffers.size() < pool.size())
+		page_buffers.push_back(std::move(buffer));
+}
+
+#include "source/snippets.hpp"
 #include "source/head_gen.hpp"
 #include "source/navbar_gen.hpp"
 #include "source/sidebar_gen.hpp"
 #include "source/content_gen.hpp"
+#include "source/navigation_gen.hpp"
+#include "source/offline_gen.hpp"
+#include "source/split_gen.hpp"
+#include "source/assets.hpp"
+#include "source/directory_scan.hpp"
+#include "source/archive.hpp"
 
 #define throw_error(condition, _message) do { if (condition) {if (message != nullptr) message(_message); return false;} } while(0);
 
-bool litedocs::generate_docs(
+#include "source/page_gen.hpp"
+#include "source/pipeline.hpp"
+#include "source/preview.hpp"
+#include "source/shards.hpp"
+
+litedocs::generator::generator(const generator_settings& settings)
+{
+	state = new litedocs_internal::generator_state(settings);
+}
+
+litedocs::generator::~generator()
+{
+	delete state;
+}
+
+bool litedocs::generator::generate(
 	const std::string& project_file_filepath,
 	load_file_callback load_file,
 	save_page_callback save_file,
-	message_callback message
+	message_callback message,
+	save_asset_callback save_asset
 )
 {
-	/*
-		Load project
-	*/
+	return generate_batch({ project_file_filepath }, load_file, save_file, message, save_asset);
+}
 
-	std::string project_filename;
-	std::string project_folder;
+bool litedocs::generator::generate_batch(
+	const std::vector<std::string>& project_files_filepaths,
+	load_file_callback load_file,
+	save_page_callback save_file,
+	message_callback message,
+	save_asset_callback save_asset,
+	std::vector<bool>* succeeded
+)
+{
+	using namespace litedocs_internal;
 
-	{
-		size_t found;
-		found = project_file_filepath.find_last_of("/\\");
+	bool success = true;
 
-		project_folder = project_file_filepath.substr(0, found);
-		project_filename = project_file_filepath.substr(found + 1);
-	}
+	std::vector<std::unique_ptr<project_job>> jobs;
 
-	loaded_file project_file = load_file(project_filename, project_folder);
-	throw_error(!project_file.success, "[Error] Missing project file");
+	//Position of every job in the project files
+	std::vector<size_t> job_projects;
 
-	nlohmann::json project_json;
-	litedocs_internal::project project;
-	try
-	{
-		project_json = nlohmann::json::parse(project_file.content);
-	}
-	catch (const std::exception& exc)
-	{
-		message("[Error] " + std::string(exc.what()));
-		message("[Error] Failed to load project");
-		return false;
-	}
-	
-	throw_error(!litedocs_internal::read_project(project, project_json, message), "[Error] Failed to load project");
+	if (succeeded != nullptr)
+		succeeded->assign(project_files_filepaths.size(), false);
 
-	/*
-		Generate Head, Navbar and Sidebar
-	*/
+	for (size_t i = 0; i < project_files_filepaths.size(); i++)
+	{
+		auto job = std::make_unique<project_job>();
 
-	std::string head;	 litedocs_internal::generate_unclosed_head(head, project);
-	std::string navbar;  litedocs_internal::generate_navbar(navbar, project);
-	std::string sidebar; litedocs_internal::generate_sidebar(sidebar, project);
+		if (load_project_job(*state, *job, project_files_filepaths.at(i), load_file, message))
+		{
+			jobs.push_back(std::move(job));
+			job_projects.push_back(i);
+		}
+		else
+			success = false;
+	}
 
 	/*
-		For each page, generate the content and the .html site
+		Render pages of all projects on the same threads,
+		while the next pages are loaded and the previous ones saved
 	*/
 
-	std::string base = "./";
-	std::vector<const std::string*> sections;
+	pages_pipeline pipeline(*state, load_file, save_file, message);
+	pipeline.run(jobs);
 
-	for (size_t i = 0; i < project.pages_order.size(); i++)
+	for (size_t i = 0; i < jobs.size(); i++)
 	{
-		const auto& page = project.pages_order.at(i);
+		auto& job = jobs.at(i);
 
-		//Keep base a root directory using relative paths
-		if (page.is_go_down && i != 0)
+		if (job->failed)
 		{
-			base += "../";
-			sections.push_back(&project.pages_order.at(i - 1).page_name_undescores);
+			success = false;
+			continue;
 		}
-		else if (page.is_go_up && sections.size() != 0)
+
+		bool finished = run_reported(message, [&]()
 		{
-			sections.pop_back();
-			base.erase(base.end() - 3, base.end());
-		}
+			finish_project_job(*state, *job, load_file, save_file, message, save_asset);
+			return true;
+		});
 
-		if (page.is_go_down || page.is_go_up) continue;
+		if (succeeded != nullptr)
+			succeeded->at(job_projects.at(i)) = finished;
 
-		auto content_source = load_file(page.file, project_folder);
-		throw_error(!content_source.success, "[Error] Failed to load file: " + page.file);
+		success = finished && success;
+	}
 
-		std::stringstream out_stream;
+	return success;
+}
 
-		out_stream << head;
+bool litedocs::generator::generate_shard(
+	const std::string& project_file_filepath,
+	size_t shard_index,
+	size_t shard_count,
+	load_file_callback load_file,
+	save_page_callback save_file,
+	message_callback message,
+	std::string& shard_manifest
+)
+{
+	using namespace litedocs_internal;
 
-		out_stream << "</head>";
+	throw_error(shard_index >= shard_count, "[Error] Invalid shard " + std::to_string(shard_index + 1) + "/" + std::to_string(shard_count));
 
-		out_stream << "<body bgcolor=" << project.content_background << " >";
-		out_stream << navbar;
-		out_stream << "<div class=\"main\">";
-		out_stream << sidebar;
-		
-		litedocs_internal::generate_content(out_stream, content_source.content, project);
+	std::vector<std::unique_ptr<project_job>> jobs;
+	jobs.push_back(std::make_unique<project_job>());
 
-		out_stream << R"(</div></body></html>)";
+	auto& job = *jobs.back();
+	if (!load_project_job(*state, job, project_file_filepath, load_file, message)) return false;
 
-		std::string result = out_stream.str();
+	size_t project_pages = job.pages.size();
+	auto shards = assign_shard_pages(job, shard_count);
 
-		generated_page gen_page;
-		gen_page.page_name = page.page_name_undescores;
-		gen_page.sections = &sections;
-		gen_page.content = &result;
+	std::vector<page_job> pages;
+	for (size_t i = 0; i < job.pages.size(); i++)
+		if (shards.at(i) == shard_index)
+			pages.push_back(std::move(job.pages.at(i)));
 
-		save_file(&gen_page, project_folder);
-	}
+	job.pages = std::move(pages);
+	job.hash_pages = true;
+
+	pages_pipeline pipeline(*state, load_file, save_file, message);
+	pipeline.run(jobs);
+
+	if (job.failed) return false;
+
+	std::ostringstream manifest;
+	write_shard_manifest(job, shard_index, shard_count, project_pages, manifest);
+	shard_manifest = manifest.str();
+
+	if (message != nullptr) message(describe_shard_time(job, shard_index, shard_count));
+	return true;
+}
+
+bool litedocs::generator::merge_shards(
+	const std::string& project_file_filepath,
+	const std::vector<std::string>& shard_manifests,
+	load_file_callback load_file,
+	save_page_callback save_file,
+	message_callback message,
+	save_asset_callback save_asset,
+	load_file_callback load_saved_page
+)
+{
+	using namespace litedocs_internal;
+
+	project_job job;
+	if (!load_project_job(*state, job, project_file_filepath, load_file, message)) return false;
+
+	size_t shard_count = 0;
+	std::vector<size_t> covered(job.pages.size(), 0);
+
+	for (auto& manifest : shard_manifests)
+		if (!read_shard_manifest(job, manifest, shard_count, covered, message)) return false;
+
+	throw_error(shard_manifests.size() != shard_count, "[Error] Expected " + std::to_string(shard_count) + " shards, got " + std::to_string(shard_manifests.size()));
+
+	for (size_t i = 0; i < covered.size(); i++)
+		throw_error(covered.at(i) != 1, "[Error] Page in " + std::to_string(covered.at(i)) + " shards: " + job.pages.at(i).page->file);
+
+	return run_reported(message, [&]()
+	{
+		if (load_saved_page != nullptr && !verify_shard_pages(*state, job, load_saved_page, message))
+			return false;
+
+		finish_project_job(*state, job, load_file, save_file, message, save_asset);
+		return true;
+	});
+}
+
+bool litedocs::generator::load_project(
+	const std::string& project_file_filepath,
+	load_file_callback load_file,
+	message_callback message,
+	loaded_project& project
+)
+{
+	auto job = std::make_unique<litedocs_internal::project_job>();
+	if (!litedocs_internal::load_project_job(*state, *job, project_file_filepath, load_file, message)) return false;
+
+	delete project.job;
+	project.job = job.release();
 
 	return true;
 }
 
+bool litedocs::generator::render_page(
+	loaded_project& project,
+	const std::string& page_file,
+	std::string& html,
+	const std::string* markdown,
+	std::string* stylesheet
+)
+{
+	if (project.job == nullptr) return false;
+	return litedocs_internal::run_reported(project.job->message, [&]()
+	{
+		return litedocs_internal::render_preview(*state, *project.job, page_file, markdown, html, stylesheet);
+	});
+}
+
+litedocs::loaded_project::~loaded_project()
+{
+	delete job;
+}
+
+void litedocs::generator::save_directory_cache(std::ostream& out)
+{
+	litedocs_internal::save_directory_cache(*state, out);
+}
+
+void litedocs::generator::load_directory_cache(std::istream& in)
+{
+	litedocs_internal::load_directory_cache(*state, in);
+}
+
+void litedocs::generator::save_asset_cache(std::ostream& out)
+{
+	litedocs_internal::save_asset_cache(*state, out);
+}
+
+void litedocs::generator::load_asset_cache(std::istream& in)
+{
+	litedocs_internal::load_asset_cache(*state, in);
+}
+
+bool litedocs::generate_docs(
+	const std::string& project_file_filepath,
+	load_file_callback load_file,
+	save_page_callback save_file,
+	message_callback message,
+	save_asset_callback save_asset
+)
+{
+	generator_settings settings;
+	settings.threads = 1;
+
+	generator gen(settings);
+	return gen.generate(project_file_filepath, load_file, save_file, message, save_asset);
+}
+
+bool litedocs::generate_docs_batch(
+	const std::vector<std::string>& project_files_filepaths,
+	load_file_callback load_file,
+	save_page_callback save_file,
+	message_callback message,
+	save_asset_callback save_asset,
+	size_t threads
+)
+{
+	generator_settings settings;
+	settings.threads = threads;
+
+	generator gen(settings);
+	return gen.generate_batch(project_files_filepaths, load_file, save_file, message, save_asset);
+}
+
+litedocs::archive_writer::~archive_writer()
+{
+	close();
+}
+
+bool litedocs::archive_writer::open(const std::string& path)
+{
+	close();
+
+	state = new litedocs_internal::archive_writer_state;
+	state->path = path;
+	state->file.open(path, std::ios::binary | std::ios::trunc);
+
+	return state->file.good();
+}
+
+bool litedocs::archive_writer::add_file(const std::string& name, const std::string& content)
+{
+	return add_file(name, [&](std::ostream& out) { out.write(content.data(), content.size()); });
+}
+
+bool litedocs::archive_writer::add_file(const std::string& name, const std::function<void(std::ostream&)>& write_content)
+{
+	if (state == nullptr) return false;
+
+	std::lock_guard<std::mutex> lock(state->mutex);
+	if (!state->good) return false;
+
+	state->good = litedocs_internal::write_archive_file(*state, name, write_content);
+	return state->good;
+}
+
+bool litedocs::archive_writer::add_link(const std::string& name, const std::string& target)
+{
+	if (state == nullptr) return false;
+
+	std::lock_guard<std::mutex> lock(state->mutex);
+	if (!state->good) return false;
+
+	state->good = litedocs_internal::write_archive_link(*state, name, target);
+	return state->good;
+}
+
+bool litedocs::archive_writer::close(bool write_index)
+{
+	if (state == nullptr) return false;
+
+	//Two zero blocks end a tar
+	static const char zeros[2 * litedocs_internal::tar_block] = {};
+	state->file.write(zeros, sizeof(zeros));
+
+	size_t size = static_cast<size_t>(state->file.tellp());
+	state->file.close();
+
+	bool success = state->good && !state->file.fail();
+
+	if (success && write_index)
+		success = litedocs_internal::save_archive_index(*state, size);
+
+	delete state;
+	state = nullptr;
+
+	return success;
+}
+
+litedocs::archive_reader::~archive_reader()
+{
+	close();
+}
+
+bool litedocs::archive_reader::open(const std::string& path)
+{
+	close();
+
+	state = new litedocs_internal::archive_reader_state;
+
+	bool success = litedocs_internal::map_archive(*state, path);
+
+	if (success && !litedocs_internal::load_archive_index(*state, path))
+	{
+		state->entries.clear();
+		success = litedocs_internal::scan_archive_headers(*state);
+	}
+
+	if (!success) close();
+	return success;
+}
+
+void litedocs::archive_reader::close()
+{
+	if (state == nullptr) return;
+
+	litedocs_internal::unmap_archive(*state);
+
+	delete state;
+	state = nullptr;
+}
+
+const char* litedocs::archive_reader::find(const std::string& name, size_t& size) const
+{
+	if (state == nullptr) return nullptr;
+
+	auto found = state->entries.find(name);
+	if (found == state->entries.end()) return nullptr;
+
+	size = found->second.second;
+	return state->data + found->second.first;
+}
+
+std::vector<std::string> litedocs::archive_reader::names() const
+{
+	std::vector<std::string> names;
+
+	if (state != nullptr)
+		for (auto& entry : state->entries)
+			names.push_back(entry.first);
+
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
 #undef throw_error
+#undef litedocs_profile_allocations_page
+#undef litedocs_profile_allocations
 
 #endif // LITEDOCS_IMPLEMENTATION
-
@@ -0,0 +1,311 @@
+#pragma once
+
+/*
+	Build with LITEDOCS_ALLOCATION_PROFILE to count heap allocations of every page and stage
+	Replaces the global operator new and delete, so define it in one translation unit only
+*/
+
+#ifdef LITEDOCS_ALLOCATION_PROFILE
+namespace litedocs_internal
+{
+	enum allocation_stage
+	{
+		allocation_load,
+		allocation_markdown,
+		allocation_highlight,
+		allocation_assemble,
+		allocation_save,
+		allocation_stages_count
+	};
+
+	const char* allocation_stage_names[allocation_stages_count] = { "load", "markdown", "highlight", "assemble", "save" };
+
+	struct allocation_counters
+	{
+		std::atomic<size_t> count{ 0 };
+		std::atomic<size_t> bytes{ 0 };
+
+		//Bytes allocated in this stage and not freed yet, wherever they are freed
+		std::atomic<size_t> live{ 0 };
+		std::atomic<size_t> peak{ 0 };
+
+		void allocated(size_t size)
+		{
+			count++;
+			bytes += size;
+
+			size_t now = live += size;
+			size_t previous_peak = peak;
+			while (now > previous_peak && !peak.compare_exchange_weak(previous_peak, now));
+		}
+	};
+
+	struct page_allocations
+	{
+		//Project folder and page file
+		std::string page;
+		allocation_counters stages[allocation_stages_count];
+	};
+
+	struct allocation_profile
+	{
+		std::mutex mutex;
+
+		//Deque, so the counters never move
+		std::deque<page_allocations> pages;
+		std::map<std::string, page_allocations*> pages_by_name;
+
+		page_allocations* get_page(const std::string& page);
+	};
+
+	//Allocations outside of any page stage
+	allocation_counters unattributed_allocations;
+
+	thread_local page_allocations* current_allocation_page = nullptr;
+	thread_local allocation_counters* current_allocation_counters = nullptr;
+
+	//Never destroyed, memory freed by static destructors still points to its counters
+	allocation_profile& get_allocation_profile()
+	{
+		static allocation_profile* profile = new allocation_profile;
+		return *profile;
+	}
+
+	page_allocations* allocation_profile::get_page(const std::string& page)
+	{
+		//The profile's own allocations aren't counted
+		auto previous_counters = current_allocation_counters;
+		current_allocation_counters = nullptr;
+
+		page_allocations* result;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto& found = pages_by_name[page];
+			if (found == nullptr)
+			{
+				pages.emplace_back();
+				pages.back().page = page;
+				found = &pages.back();
+			}
+			result = found;
+		}
+
+		current_allocation_counters = previous_counters;
+		return result;
+	}
+
+	//Attributes allocations of the current thread to the page, until a stage starts
+	struct allocation_page_scope
+	{
+		page_allocations* previous_page;
+		allocation_counters* previous_counters;
+
+		allocation_page_scope(const std::string& page)
+			: previous_page(current_allocation_page), previous_counters(current_allocation_counters)
+		{
+			current_allocation_page = get_allocation_profile().get_page(page);
+			current_allocation_counters = nullptr;
+		}
+
+		~allocation_page_scope()
+		{
+			current_allocation_page = previous_page;
+			current_allocation_counters = previous_counters;
+		}
+	};
+
+	//Attributes allocations of the current thread to a stage of the current page
+	struct allocation_stage_scope
+	{
+		allocation_counters* previous_counters;
+
+		allocation_stage_scope(allocation_stage stage) : previous_counters(current_allocation_counters)
+		{
+			if (current_allocation_page != nullptr)
+				current_allocation_counters = &current_allocation_page->stages[stage];
+		}
+
+		~allocation_stage_scope()
+		{
+			current_allocation_counters = previous_counters;
+		}
+	};
+
+	//Stored before every block, so delete knows what to subtract the size from
+	struct alignas(std::max_align_t) allocation_header
+	{
+		size_t size;
+		allocation_counters* counters;
+	};
+
+	std::string escape_json_string(const std::string& text)
+	{
+		std::string result;
+
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\') result += '\\';
+			if (static_cast<unsigned char>(c) < 0x20) { result += ' '; continue; }
+			result += c;
+		}
+
+		return result;
+	}
+
+	struct allocation_report_row
+	{
+		std::string page;
+		std::string stage;
+		size_t count;
+		size_t bytes;
+		size_t peak;
+	};
+
+	std::vector<allocation_report_row> get_allocation_report_rows()
+	{
+		std::vector<allocation_report_row> rows;
+		auto& profile = get_allocation_profile();
+
+		std::lock_guard<std::mutex> lock(profile.mutex);
+
+		for (auto& page : profile.pages)
+			for (size_t stage = 0; stage < allocation_stages_count; stage++)
+			{
+				auto& counters = page.stages[stage];
+				if (counters.count == 0) continue;
+
+				rows.push_back({ page.page, allocation_stage_names[stage], counters.count, counters.bytes, counters.peak });
+			}
+
+		return rows;
+	}
+}
+
+#define litedocs_profile_allocations_page(page) litedocs_internal::allocation_page_scope _allocation_page_scope(page)
+#define litedocs_profile_allocations(stage) litedocs_internal::allocation_stage_scope _allocation_stage_scope(litedocs_internal::allocation_##stage)
+
+void* operator new(size_t size)
+{
+	using namespace litedocs_internal;
+
+	auto* header = static_cast<allocation_header*>(std::malloc(sizeof(allocation_header) + size));
+	if (header == nullptr) throw std::bad_alloc();
+
+	header->size = size;
+	header->counters = current_allocation_counters != nullptr ? current_allocation_counters : &unattributed_allocations;
+	header->counters->allocated(size);
+
+	return header + 1;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	using namespace litedocs_internal;
+
+	if (ptr == nullptr) return;
+
+	auto* header = static_cast<allocation_header*>(ptr) - 1;
+	header->counters->live -= header->size;
+
+	std::free(header);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+/*
+	Report
+*/
+
+void litedocs::write_allocation_report(std::ostream& out, const std::string& sort_by)
+{
+	using namespace litedocs_internal;
+
+	auto rows = get_allocation_report_rows();
+
+	std::stable_sort(rows.begin(), rows.end(), [&](const allocation_report_row& a, const allocation_report_row& b)
+	{
+		if (sort_by == "page") return a.page < b.page;
+		if (sort_by == "stage") return a.stage < b.stage;
+		if (sort_by == "count") return a.count > b.count;
+		if (sort_by == "peak") return a.peak > b.peak;
+		return a.bytes > b.bytes;
+	});
+
+	//Totals of every stage first
+	size_t stage_count[allocation_stages_count] = {};
+	size_t stage_bytes[allocation_stages_count] = {};
+	auto& profile = get_allocation_profile();
+	{
+		std::lock_guard<std::mutex> lock(profile.mutex);
+		for (auto& page : profile.pages)
+			for (size_t stage = 0; stage < allocation_stages_count; stage++)
+			{
+				stage_count[stage] += page.stages[stage].count;
+				stage_bytes[stage] += page.stages[stage].bytes;
+			}
+	}
+
+	auto column = [&](const std::string& text, size_t width, bool right)
+	{
+		if (!right) out << text;
+		for (size_t i = text.size(); i < width; i++) out << ' ';
+		if (right) out << text;
+	};
+
+	auto line = [&](const std::string& page, const std::string& stage, const std::string& count, const std::string& bytes, const std::string& peak)
+	{
+		column(page, 48, false);
+		column(stage, 10, false);
+		column(count, 12, true);
+		column(bytes, 16, true);
+		column(peak, 16, true);
+		out << '\n';
+	};
+
+	line("page", "stage", "allocations", "bytes", "peak live");
+
+	for (size_t stage = 0; stage < allocation_stages_count; stage++)
+		line("(all pages)", allocation_stage_names[stage], std::to_string(stage_count[stage]), std::to_string(stage_bytes[stage]), "");
+
+	line(
+		"(outside of pages)", "",
+		std::to_string(unattributed_allocations.count), std::to_string(unattributed_allocations.bytes), std::to_string(unattributed_allocations.peak)
+	);
+
+	out << '\n';
+
+	for (auto& row : rows)
+		line(row.page + ' ', row.stage, std::to_string(row.count), std::to_string(row.bytes), std::to_string(row.peak));
+}
+
+void litedocs::write_allocation_report_json(std::ostream& out)
+{
+	using namespace litedocs_internal;
+
+	auto rows = get_allocation_report_rows();
+
+	out << "{\n\t\"unattributed\": { \"count\": " << unattributed_allocations.count
+		<< ", \"bytes\": " << unattributed_allocations.bytes
+		<< ", \"peak\": " << unattributed_allocations.peak << " },\n";
+
+	out << "\t\"pages\": [";
+
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		auto& row = rows.at(i);
+
+		out << (i == 0 ? "\n" : ",\n");
+		out << "\t\t{ \"page\": \"" << escape_json_string(row.page) << "\", \"stage\": \"" << row.stage
+			<< "\", \"count\": " << row.count << ", \"bytes\": " << row.bytes << ", \"peak\": " << row.peak << " }";
+	}
+
+	out << "\n\t]\n}\n";
+}
+#else
+	#define litedocs_profile_allocations_page(page)
+	#define litedocs_profile_allocations(stage)
+#endif
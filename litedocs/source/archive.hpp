@@ -0,0 +1,344 @@
+#pragma once
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace litedocs_internal
+{
+	/*
+		Ustar archives, so a whole build is one file any tar tool can unpack
+		Headers carry no times or owners, the same pages give the same bytes
+	*/
+	constexpr size_t tar_block = 512;
+
+	struct archive_entry
+	{
+		std::string name;
+
+		//Of the content, right after the header
+		size_t offset = 0;
+		size_t size = 0;
+	};
+
+	struct archive_writer_state
+	{
+		std::mutex mutex;
+		std::string path;
+		std::ofstream file;
+
+		std::vector<archive_entry> entries;
+
+		//key	: name
+		//value : index in entries
+		std::unordered_map<std::string, size_t> entry_indices;
+
+		bool good = true;
+	};
+
+	void write_tar_octal(char* field, size_t field_size, size_t value)
+	{
+		//Zero padded, the last byte stays a terminator
+		for (size_t i = field_size - 1; i-- > 0;)
+		{
+			field[i] = static_cast<char>('0' + (value & 7));
+			value >>= 3;
+		}
+	}
+
+	size_t read_tar_octal(const char* field, size_t field_size)
+	{
+		size_t value = 0;
+
+		for (size_t i = 0; i < field_size && field[i] != '\0'; i++)
+		{
+			if (field[i] == ' ') continue;
+			if (field[i] < '0' || field[i] > '7') break;
+			value = (value << 3) | static_cast<size_t>(field[i] - '0');
+		}
+
+		return value;
+	}
+
+	//Type is '0' for files, '1' for hard links and 'L' for the long name records
+	void fill_tar_header(char* header, const std::string& name, size_t size, char type, const std::string& link_name)
+	{
+		std::memset(header, 0, tar_block);
+
+		std::memcpy(header, name.data(), std::min<size_t>(name.size(), 100));
+		std::memcpy(header + 100, "0000644", 7);
+		std::memcpy(header + 108, "0000000", 7);
+		std::memcpy(header + 116, "0000000", 7);
+		write_tar_octal(header + 124, 12, size);
+		write_tar_octal(header + 136, 12, 0);
+		header[156] = type;
+		std::memcpy(header + 157, link_name.data(), std::min<size_t>(link_name.size(), 100));
+		std::memcpy(header + 257, "ustar", 6);
+		std::memcpy(header + 263, "00", 2);
+
+		//Checksum counts its own field as spaces
+		std::memset(header + 148, ' ', 8);
+
+		size_t checksum = 0;
+		for (size_t i = 0; i < tar_block; i++)
+			checksum += static_cast<unsigned char>(header[i]);
+
+		write_tar_octal(header + 148, 7, checksum);
+		header[155] = ' ';
+	}
+
+	void write_tar_padding(std::ostream& out, size_t size)
+	{
+		static const char zeros[tar_block] = {};
+
+		if (size % tar_block != 0)
+			out.write(zeros, tar_block - size % tar_block);
+	}
+
+	//Names over 100 bytes go in a GNU long name record before the header
+	void write_tar_long_name(std::ostream& out, const std::string& name, char type)
+	{
+		char header[tar_block];
+		fill_tar_header(header, "././@LongLink", name.size() + 1, type, "");
+
+		out.write(header, tar_block);
+		out.write(name.c_str(), name.size() + 1);
+		write_tar_padding(out, name.size() + 1);
+	}
+
+	//Writes the header, then the content, then goes back to put the size in the header
+	//Expects locked mutex
+	bool write_archive_file(archive_writer_state& archive, const std::string& name, const std::function<void(std::ostream&)>& write_content)
+	{
+		auto& out = archive.file;
+
+		if (name.size() > 100)
+			write_tar_long_name(out, name, 'L');
+
+		size_t header_offset = static_cast<size_t>(out.tellp());
+
+		char header[tar_block];
+		fill_tar_header(header, name, 0, '0', "");
+		out.write(header, tar_block);
+
+		size_t content_offset = header_offset + tar_block;
+		write_content(out);
+
+		size_t size = static_cast<size_t>(out.tellp()) - content_offset;
+		write_tar_padding(out, size);
+
+		fill_tar_header(header, name, size, '0', "");
+		out.seekp(header_offset);
+		out.write(header, tar_block);
+		out.seekp(0, std::ios::end);
+
+		if (!out.good()) return false;
+
+		archive.entry_indices[name] = archive.entries.size();
+		archive.entries.push_back({ name, content_offset, size });
+
+		return true;
+	}
+
+	//Expects locked mutex
+	bool write_archive_link(archive_writer_state& archive, const std::string& name, const std::string& target)
+	{
+		auto found = archive.entry_indices.find(target);
+		if (found == archive.entry_indices.end()) return false;
+
+		auto& out = archive.file;
+
+		if (target.size() > 100)
+			write_tar_long_name(out, target, 'K');
+
+		if (name.size() > 100)
+			write_tar_long_name(out, name, 'L');
+
+		char header[tar_block];
+		fill_tar_header(header, name, 0, '1', target);
+		out.write(header, tar_block);
+
+		if (!out.good()) return false;
+
+		//Readers using the index get the target's content directly
+		archive_entry entry = archive.entries.at(found->second);
+		entry.name = name;
+
+		archive.entry_indices[name] = archive.entries.size();
+		archive.entries.push_back(std::move(entry));
+
+		return true;
+	}
+
+	/*
+		Index next to the archive, one line per entry: content offset, size and name
+		The first line has the archive size, so an index of an older archive is ignored
+	*/
+	const char* archive_index_magic = "litedocs-archive-index";
+
+	bool save_archive_index(const archive_writer_state& archive, size_t archive_size)
+	{
+		std::ofstream index(archive.path + ".index", std::ios::binary);
+
+		index << archive_index_magic << ' ' << archive_size << '\n';
+		for (auto& entry : archive.entries)
+			index << entry.offset << ' ' << entry.size << ' ' << entry.name << '\n';
+
+		return index.good();
+	}
+
+	/*
+		Reading
+	*/
+
+	struct archive_reader_state
+	{
+		const char* data = nullptr;
+		size_t size = 0;
+
+#if defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+#elif !defined(__linux__)
+		std::string content;
+#endif
+
+		//key	: name
+		//value : content offset and size
+		std::unordered_map<std::string, std::pair<size_t, size_t>> entries;
+	};
+
+	bool map_archive(archive_reader_state& archive, const std::string& path)
+	{
+#if defined(_WIN32)
+		archive.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (archive.file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(archive.file, &size)) return false;
+
+		archive.size = static_cast<size_t>(size.QuadPart);
+		if (archive.size == 0) return true;
+
+		archive.mapping = CreateFileMappingA(archive.file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (archive.mapping == NULL) return false;
+
+		archive.data = static_cast<const char*>(MapViewOfFile(archive.mapping, FILE_MAP_READ, 0, 0, 0));
+		return archive.data != nullptr;
+#elif defined(__linux__)
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0) return false;
+
+		struct stat info;
+		if (fstat(file, &info) != 0) { close(file); return false; }
+
+		archive.size = static_cast<size_t>(info.st_size);
+
+		void* data = archive.size != 0 ? mmap(nullptr, archive.size, PROT_READ, MAP_SHARED, file, 0) : nullptr;
+		close(file);
+
+		if (data == MAP_FAILED) return false;
+
+		archive.data = static_cast<const char*>(data);
+		return true;
+#else
+		std::ifstream file(path, std::ios::binary);
+		if (!file.good()) return false;
+
+		archive.content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		archive.data = archive.content.data();
+		archive.size = archive.content.size();
+		return true;
+#endif
+	}
+
+	void unmap_archive(archive_reader_state& archive)
+	{
+#if defined(_WIN32)
+		if (archive.data != nullptr) UnmapViewOfFile(archive.data);
+		if (archive.mapping != NULL) CloseHandle(archive.mapping);
+		if (archive.file != INVALID_HANDLE_VALUE) CloseHandle(archive.file);
+#elif defined(__linux__)
+		if (archive.data != nullptr) munmap(const_cast<char*>(archive.data), archive.size);
+#endif
+		archive.data = nullptr;
+		archive.size = 0;
+	}
+
+	bool load_archive_index(archive_reader_state& archive, const std::string& path)
+	{
+		std::ifstream index(path + ".index");
+		if (!index.good()) return false;
+
+		std::string magic;
+		size_t archive_size = 0;
+		if (!(index >> magic >> archive_size) || magic != archive_index_magic || archive_size != archive.size) return false;
+
+		size_t offset, size;
+		std::string name;
+
+		while (index >> offset >> size && std::getline(index.ignore(1), name))
+		{
+			if (offset + size > archive.size) { archive.entries.clear(); return false; }
+			archive.entries[name] = { offset, size };
+		}
+
+		return true;
+	}
+
+	//Walks the headers without touching the contents, for archives without an index
+	bool scan_archive_headers(archive_reader_state& archive)
+	{
+		std::string long_name, long_link;
+
+		for (size_t offset = 0; offset + tar_block <= archive.size;)
+		{
+			const char* header = archive.data + offset;
+
+			//Two zero blocks end the archive, one is enough to stop
+			if (header[0] == '\0') return true;
+
+			size_t checksum = 0;
+			for (size_t i = 0; i < tar_block; i++)
+				checksum += i >= 148 && i < 156 ? ' ' : static_cast<unsigned char>(header[i]);
+			if (checksum != read_tar_octal(header + 148, 8)) return false;
+
+			size_t size = read_tar_octal(header + 124, 12);
+			size_t content_offset = offset + tar_block;
+			char type = header[156];
+
+			if (content_offset + size > archive.size) return false;
+			offset = content_offset + (size + tar_block - 1) / tar_block * tar_block;
+
+			if (type == 'L' || type == 'K')
+			{
+				(type == 'L' ? long_name : long_link) = std::string(archive.data + content_offset, strnlen(archive.data + content_offset, size));
+				continue;
+			}
+
+			std::string name = !long_name.empty() ? long_name : std::string(header, strnlen(header, 100));
+			std::string link = !long_link.empty() ? long_link : std::string(header + 157, strnlen(header + 157, 100));
+
+			//Ustar splits long names into a prefix and a name
+			if (long_name.empty() && header[345] != '\0' && std::memcmp(header + 257, "ustar", 5) == 0)
+				name = std::string(header + 345, strnlen(header + 345, 155)) + "/" + name;
+
+			long_name.clear();
+			long_link.clear();
+
+			if (type == '0' || type == '\0')
+				archive.entries[name] = { content_offset, size };
+			else if (type == '1')
+			{
+				auto target = archive.entries.find(link);
+				if (target != archive.entries.end())
+					archive.entries[name] = target->second;
+			}
+		}
+
+		return true;
+	}
+}
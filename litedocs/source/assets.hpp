@@ -0,0 +1,278 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	/*
+		Local files (images, downloads etc.) referenced from the pages
+	*/
+	struct asset_references
+	{
+		//key	: asset path relative to the project folder
+		//value : paths relative to the build folder, where the pages expect it
+		std::map<std::string, std::set<std::string>> destinations;
+	};
+
+	bool is_local_asset_link(const std::string& link)
+	{
+		if (link.empty()) return false;
+		if (link[0] == '/' || link[0] == '\\' || link[0] == '#') return false;
+
+		//Any scheme, like https:, mailto: or data:
+		size_t colon = link.find(':');
+		if (colon != std::string::npos && link.find_first_of("/\\") > colon) return false;
+
+		//Links to other pages
+		std::string extension = std::filesystem::path(link).extension().string();
+		if (extension == ".md" || extension == ".html" || extension == "") return false;
+
+		return true;
+	}
+
+	//Begins and ends of the <pre> and <code> elements, whose text only shows html
+	std::vector<std::pair<size_t, size_t>> find_code_ranges(const std::string& html)
+	{
+		std::vector<std::pair<size_t, size_t>> ranges;
+
+		for (size_t offset = html.find('<'); offset != std::string::npos; offset = html.find('<', offset + 1))
+		{
+			const char* closing = nullptr;
+
+			if (html.compare(offset, 4, "<pre") == 0 && (html[offset + 4] == '>' || html[offset + 4] == ' ')) closing = "</pre>";
+			else if (html.compare(offset, 5, "<code") == 0 && (html[offset + 5] == '>' || html[offset + 5] == ' ')) closing = "</code>";
+
+			if (closing == nullptr) continue;
+
+			size_t end = html.find(closing, offset);
+			end = end == std::string::npos ? html.size() : end + std::strlen(closing);
+
+			ranges.push_back({ offset, end });
+			offset = end - 1;
+		}
+
+		return ranges;
+	}
+
+	//Appends the values of src and href attributes pointing to local files
+	//Attributes in code blocks and inline code are text shown on the page, not links
+	void collect_local_links(const std::string& html, std::vector<std::string>& links)
+	{
+		auto code_ranges = find_code_ranges(html);
+
+		for (const char* attribute : { "src=", "href=" })
+		{
+			size_t offset = 0;
+			size_t range = 0;
+
+			while ((offset = html.find(attribute, offset)) != std::string::npos)
+			{
+				while (range < code_ranges.size() && code_ranges.at(range).second <= offset) range++;
+
+				if (range < code_ranges.size() && code_ranges.at(range).first <= offset)
+				{
+					offset = code_ranges.at(range).second;
+					continue;
+				}
+
+				offset += std::strlen(attribute);
+				if (offset >= html.size()) break;
+
+				char quote = html[offset];
+				if (quote != '"' && quote != '\'') continue;
+
+				size_t end = html.find(quote, offset + 1);
+				if (end == std::string::npos) break;
+
+				std::string link = html.substr(offset + 1, end - offset - 1);
+				offset = end + 1;
+
+				//Cut query and fragment
+				link = link.substr(0, link.find_first_of("?#"));
+
+				if (is_local_asset_link(link))
+					links.push_back(link);
+			}
+		}
+	}
+
+	//Resolves links of a page, relative to its source file and to its .html file
+	void add_page_assets(
+		asset_references& assets,
+		const std::vector<std::string>& links,
+		const std::string& page_file,
+		const std::string& page_output_path
+	)
+	{
+		auto source_dir = std::filesystem::path(page_file).parent_path();
+		auto output_dir = std::filesystem::path(page_output_path).parent_path();
+
+		for (auto& link : links)
+		{
+			auto source = (source_dir / link).lexically_normal().generic_string();
+			auto destination = (output_dir / link).lexically_normal().generic_string();
+
+			//Files outside of the project or build folder are left alone
+			if (source.rfind("..", 0) == 0 || destination.rfind("..", 0) == 0) continue;
+
+			assets.destinations[source].insert(destination);
+		}
+	}
+
+	//Hashes the file from the disk in chunks, unless it has the same size and modification time as when hashed before
+	//Files which can't be read from the disk are loaded with load_file
+	bool hash_asset(
+		generator_state& generator,
+		const std::string& project_folder,
+		const std::string& file,
+		litedocs::load_file_callback load_file,
+		std::string& hash,
+		size_t& size
+	)
+	{
+		auto path = std::filesystem::path(project_folder) / file;
+		auto key = path.generic_string();
+
+		std::error_code error;
+		size_t file_size = static_cast<size_t>(std::filesystem::file_size(path, error));
+		auto time = std::filesystem::last_write_time(path, error);
+
+		if (!error)
+		{
+			long long modification_time = static_cast<long long>(time.time_since_epoch().count());
+
+			{
+				std::lock_guard<std::mutex> lock(generator.asset_hashes.mutex);
+
+				auto found = generator.asset_hashes.hashes.find(key);
+				if (found != generator.asset_hashes.hashes.end() && found->second.size == file_size && found->second.modification_time == modification_time)
+				{
+					hash = found->second.hash;
+					size = file_size;
+					return true;
+				}
+			}
+
+			std::ifstream in(path, std::ios::binary);
+			content_hasher hasher;
+			size_t hashed = 0;
+
+			char buffer[64 * 1024];
+			while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0)
+			{
+				hasher.add(buffer, static_cast<size_t>(in.gcount()));
+				hashed += static_cast<size_t>(in.gcount());
+			}
+
+			if (!in.bad() && hashed == file_size)
+			{
+				hash = hasher.digest();
+				size = file_size;
+
+				std::lock_guard<std::mutex> lock(generator.asset_hashes.mutex);
+				generator.asset_hashes.hashes[key] = { file_size, modification_time, hash };
+
+				return true;
+			}
+		}
+
+		auto loaded = load_file(file, project_folder);
+		if (!loaded.success) return false;
+
+		hash = content_hash(loaded.content);
+		size = loaded.content.size();
+
+		return true;
+	}
+
+	//Hashes every referenced asset once on the worker pool, and saves files with the same content as one staged asset
+	void stage_assets(
+		generator_state& generator,
+		const asset_references& assets,
+		const std::string& project_folder,
+		litedocs::load_file_callback load_file,
+		litedocs::save_asset_callback save_asset,
+		litedocs::message_callback message,
+		std::vector<precache_entry>* precache = nullptr
+	)
+	{
+		struct hashed_asset
+		{
+			bool found = false;
+			std::string hash;
+			size_t size = 0;
+		};
+
+		std::vector<hashed_asset> hashed(assets.destinations.size());
+		worker_pool::task_group hashing;
+
+		{
+			size_t i = 0;
+			for (auto& asset : assets.destinations)
+			{
+				hashed_asset* result = &hashed.at(i++);
+				const std::string* file = &asset.first;
+
+				generator.pool.submit(hashing, [&generator, &project_folder, load_file, result, file]()
+				{
+					result->found = hash_asset(generator, project_folder, *file, load_file, result->hash, result->size);
+				});
+			}
+		}
+
+		generator.pool.wait(hashing);
+
+		std::map<std::string, litedocs::staged_asset> by_hash;
+		size_t i = 0;
+
+		for (auto& asset : assets.destinations)
+		{
+			auto& file = hashed.at(i++);
+
+			if (!file.found)
+			{
+				if (message != nullptr) message("[Warning] Missing asset: " + asset.first);
+				continue;
+			}
+
+			auto& staged = by_hash[file.hash];
+			if (staged.source.empty())
+			{
+				staged.source = asset.first;
+				staged.content_hash = file.hash;
+				staged.size = file.size;
+			}
+
+			for (auto& destination : asset.second)
+				staged.destinations.push_back(destination);
+		}
+
+		for (auto& staged : by_hash)
+		{
+			std::sort(staged.second.destinations.begin(), staged.second.destinations.end());
+			save_asset(&staged.second, project_folder);
+
+			if (precache != nullptr)
+				for (auto& destination : staged.second.destinations)
+					precache->push_back({ "/" + destination, staged.first });
+		}
+	}
+
+	//One line per asset: size, modification time, hash and path
+	void save_asset_cache(generator_state& generator, std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(generator.asset_hashes.mutex);
+
+		for (auto& asset : generator.asset_hashes.hashes)
+			out << asset.second.size << ' ' << asset.second.modification_time << ' ' << asset.second.hash << ' ' << asset.first << '\n';
+	}
+
+	void load_asset_cache(generator_state& generator, std::istream& in)
+	{
+		std::lock_guard<std::mutex> lock(generator.asset_hashes.mutex);
+
+		asset_hash asset;
+		std::string path;
+
+		while (in >> asset.size >> asset.modification_time >> asset.hash && std::getline(in.ignore(1), path))
+			generator.asset_hashes.hashes[path] = asset;
+	}
+}
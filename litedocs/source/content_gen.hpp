@@ -4,12 +4,308 @@ namespace litedocs_internal
 {
 	extern const std::string content_format;
 
-	void generate_content(std::stringstream& outstream, const std::string& content, const project& project)
+	void collect_local_links(const std::string& html, std::vector<std::string>& links);
+
+	//Links to local files found in the content are appended to links
+	//Attributes are added to the content div
+	//snippets	: spliced in place of their placeholders, see snippets.hpp
+	template<class output>
+	void generate_content(
+		output& outstream,
+		const std::string& content,
+		const std::string& attributes,
+		const markdown_parsing::html_tags& html_tags,
+		std::vector<std::string>& links,
+		const std::vector<std::shared_ptr<snippet>>& snippets
+	)
 	{
 		outstream << "<!-- Generate Content -->";
-		outstream << R"(<div class="content">)";
+		outstream << R"(<div class="content")" << attributes << ">";
+
+		std::string html = markdown_parsing::markdown_to_html(content, html_tags);
+		splice_snippets(html, snippets);
+		collect_local_links(html, links);
+
+		outstream << html;
+
+		outstream << R"(</div>)";
+	}
+
+	bool is_line_blank(const std::string& content, size_t line_begin, size_t line_end)
+	{
+		for (size_t i = line_begin; i < line_end; i++)
+			if (content[i] != ' ' && content[i] != '\t' && content[i] != '\r')
+				return false;
+		return true;
+	}
+
+	//Returns the fence character if the line opens or closes a fenced code block, 0 otherwise
+	//Lines indented by 4 spaces or more are indented code, not fences
+	char get_code_fence(const std::string& content, size_t line_begin, size_t line_end)
+	{
+		for (size_t indent = 0; line_begin < line_end && content[line_begin] == ' '; indent++, line_begin++)
+			if (indent == 3) return 0;
+
+		if (line_end - line_begin < 3) return 0;
+
+		char c = content[line_begin];
+		if (c != '`' && c != '~') return 0;
+		if (content[line_begin + 1] != c || content[line_begin + 2] != c) return 0;
+
+		return c;
+	}
+
+	//Lines which are indented, list items, quotes or tables belong to the block above them, even after an empty line
+	bool is_line_block_start(const std::string& content, size_t line_begin, size_t line_end)
+	{
+		char c = content[line_begin];
+
+		if (c == ' ' || c == '\t' || c == '>' || c == '|') return false;
+
+		if ((c == '-' || c == '*' || c == '+') && line_begin + 1 < line_end && content[line_begin + 1] == ' ')
+			return false;
+
+		size_t i = line_begin;
+		while (i < line_end && std::isdigit(static_cast<unsigned char>(content[i])))
+			i++;
+
+		if (i != line_begin && i < line_end && (content[i] == '.' || content[i] == ')'))
+			return false;
+
+		return true;
+	}
+
+	std::string to_lower(std::string text)
+	{
+		for (auto& c : text)
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		return text;
+	}
+
+	//Html block which may contain empty lines, kept in one block until it's closed
+	struct open_html_block
+	{
+		std::string opening;
+		std::string closing;
+		size_t depth = 0;
+	};
+
+	//Elements without a closing tag
+	bool is_void_element(const std::string& name)
+	{
+		static const std::set<std::string> void_elements = {
+			"area", "base", "br", "col", "embed", "hr", "img", "input", "link", "meta", "source", "track", "wbr"
+		};
+
+		return void_elements.find(name) != void_elements.end();
+	}
+
+	//Counts the tags of the block on the line, the block is closed when depth gets back to 0
+	void update_html_block(open_html_block& block, const std::string& content, size_t line_begin, size_t line_end)
+	{
+		std::string line = to_lower(content.substr(line_begin, line_end - line_begin));
+
+		//Comments don't nest
+		if (block.opening == "<!--")
+		{
+			if (line.find(block.closing) != std::string::npos) block.depth = 0;
+			return;
+		}
+
+		for (size_t found = line.find(block.opening); found != std::string::npos; found = line.find(block.opening, found + 1))
+		{
+			char after = found + block.opening.size() < line.size() ? line[found + block.opening.size()] : ' ';
+			if (!std::isalnum(static_cast<unsigned char>(after)) && after != '-') block.depth++;
+		}
+
+		for (size_t found = line.find(block.closing); found != std::string::npos && block.depth != 0; found = line.find(block.closing, found + 1))
+			block.depth--;
+	}
+
+	//Starts tracking the html block the line begins, if any; returns whether it continues past the line
+	bool open_html_block_at(open_html_block& block, const std::string& content, size_t line_begin, size_t line_end)
+	{
+		for (size_t indent = 0; line_begin < line_end && content[line_begin] == ' '; indent++, line_begin++)
+			if (indent == 3) return false;
+
+		if (line_begin == line_end || content[line_begin] != '<') return false;
+
+		if (content.compare(line_begin, 4, "<!--") == 0)
+		{
+			block = { "<!--", "-->", 1 };
+		}
+		else
+		{
+			size_t name_end = line_begin + 1;
+			while (name_end < line_end && (std::isalnum(static_cast<unsigned char>(content[name_end])) || content[name_end] == '-'))
+				name_end++;
+
+			std::string name = to_lower(content.substr(line_begin + 1, name_end - line_begin - 1));
+			if (name.empty() || !std::isalpha(static_cast<unsigned char>(name[0])) || is_void_element(name)) return false;
+
+			block = { "<" + name, "</" + name + ">", 0 };
+		}
+
+		update_html_block(block, content, line_begin, line_end);
+		return block.depth != 0;
+	}
+
+	//Link reference definitions, like [label]: https://example.com
+	//key	: label in lower case
+	//value : the definition's line
+	using reference_definitions = std::map<std::string, std::string>;
+
+	//Label of the definition on the line, empty for other lines
+	std::string get_reference_label(const std::string& content, size_t line_begin, size_t line_end)
+	{
+		for (size_t indent = 0; line_begin < line_end && content[line_begin] == ' '; indent++, line_begin++)
+			if (indent == 3) return "";
+
+		if (line_begin == line_end || content[line_begin] != '[') return "";
+
+		size_t label_end = content.find(']', line_begin);
+		if (label_end == std::string::npos || label_end + 1 >= line_end || content[label_end + 1] != ':') return "";
+		if (label_end == line_begin + 1 || content.find('[', line_begin + 1) < label_end) return "";
+
+		return to_lower(content.substr(line_begin + 1, label_end - line_begin - 1));
+	}
+
+	//Appends the definitions of the labels used in block, so references resolve like in the whole page
+	//Definitions produce no html, so the block converts to the same html as in the page
+	void append_used_references(std::string& block, const reference_definitions& references)
+	{
+		if (references.empty()) return;
+
+		std::set<std::string> used;
+
+		for (size_t open = block.find('['); open != std::string::npos; open = block.find('[', open + 1))
+		{
+			size_t close = block.find_first_of("[]", open + 1);
+			if (close == std::string::npos) break;
+			if (block[close] != ']') continue;
+
+			auto found = references.find(to_lower(block.substr(open + 1, close - open - 1)));
+			if (found != references.end())
+				used.insert(found->second);
+		}
+
+		if (used.empty()) return;
+
+		block += "\n\n";
+		for (auto& definition : used)
+			block += definition + "\n";
+	}
+
+	//Calls on_block with every top level markdown block, splitting on empty lines outside of fenced code and html blocks
+	//Link reference definitions are found first, every block gets the ones it uses
+	template<class callback>
+	void for_each_markdown_block(const std::string& content, callback on_block)
+	{
+		reference_definitions references;
+
+		{
+			char open_fence = 0;
+
+			for (size_t line_begin = 0; line_begin < content.size();)
+			{
+				size_t line_end = content.find('\n', line_begin);
+				if (line_end == std::string::npos) line_end = content.size();
+
+				char fence = get_code_fence(content, line_begin, line_end);
+
+				if (open_fence != 0)
+				{
+					if (fence == open_fence) open_fence = 0;
+				}
+				else if (fence != 0)
+					open_fence = fence;
+				else
+				{
+					std::string label = get_reference_label(content, line_begin, line_end);
+					if (!label.empty())
+						references.insert({ label, content.substr(line_begin, line_end - line_begin) });
+				}
+
+				line_begin = line_end + 1;
+			}
+		}
+
+		auto emit = [&](std::string block)
+		{
+			append_used_references(block, references);
+			on_block(block);
+		};
+
+		size_t block_begin = 0;
+		size_t line_begin = 0;
+
+		char open_fence = 0;
+		open_html_block open_html;
+		bool after_blank_line = false;
+
+		while (line_begin < content.size())
+		{
+			size_t line_end = content.find('\n', line_begin);
+			if (line_end == std::string::npos) line_end = content.size();
+
+			char fence = get_code_fence(content, line_begin, line_end);
+
+			if (open_fence != 0)
+			{
+				if (fence == open_fence) open_fence = 0;
+			}
+			else if (open_html.depth != 0)
+			{
+				update_html_block(open_html, content, line_begin, line_end);
+			}
+			else if (is_line_blank(content, line_begin, line_end))
+			{
+				after_blank_line = true;
+			}
+			else
+			{
+				if (after_blank_line && line_begin != block_begin && is_line_block_start(content, line_begin, line_end))
+				{
+					emit(content.substr(block_begin, line_begin - block_begin));
+					block_begin = line_begin;
+				}
+
+				after_blank_line = false;
+				open_fence = fence;
+
+				if (fence == 0)
+					open_html_block_at(open_html, content, line_begin, line_end);
+			}
+
+			line_begin = line_end + 1;
+		}
+
+		if (block_begin < content.size())
+			emit(content.substr(block_begin));
+	}
+
+	//Like generate_content, but html of only one block is kept in memory at once
+	template<class output>
+	void generate_content_streamed(
+		output& outstream,
+		const std::string& content,
+		const std::string& attributes,
+		const markdown_parsing::html_tags& html_tags,
+		std::vector<std::string>& links,
+		const std::vector<std::shared_ptr<snippet>>& snippets
+	)
+	{
+		outstream << "<!-- Generate Content -->";
+		outstream << R"(<div class="content")" << attributes << ">";
+
+		for_each_markdown_block(content, [&](const std::string& block)
+		{
+			std::string html = markdown_parsing::markdown_to_html(block, html_tags);
+			splice_snippets(html, snippets);
+			collect_local_links(html, links);
 
-		outstream << markdown_parsing::markdown_to_html(content, html_tags_override);
+			outstream << html;
+		});
 
 		outstream << R"(</div>)";
 	}
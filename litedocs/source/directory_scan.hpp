@@ -0,0 +1,399 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	//Pages order entries listing a whole directory, like {"dir": "api/", "glob": "**/*.md", "sort": "name"}
+	//Files matching the glob (relative to dir) become pages, subdirectories become subsections
+	//A subdirectory's section page is the file named like it next to it (api/net.md for api/net/),
+	//otherwise its index file, otherwise its first page; with none of them its pages are not nested
+	struct directory_scan
+	{
+		generator_state& generator;
+		std::string project_folder;
+		litedocs::message_callback message;
+	};
+
+	//* matches within one path part, ** matches any number of whole parts, ? matches one character
+	bool glob_match(const char* pattern, const char* path)
+	{
+		while (*pattern != '\0')
+		{
+			if (pattern[0] == '*' && pattern[1] == '*')
+			{
+				pattern += 2;
+				if (*pattern == '/') pattern++;
+				else if (*pattern == '\0') return true;
+
+				while (true)
+				{
+					if (glob_match(pattern, path)) return true;
+
+					path = std::strchr(path, '/');
+					if (path == nullptr) return false;
+					path++;
+				}
+			}
+
+			if (*pattern == '*')
+			{
+				pattern++;
+
+				while (true)
+				{
+					if (glob_match(pattern, path)) return true;
+					if (*path == '\0' || *path == '/') return false;
+					path++;
+				}
+			}
+
+			if (*path == '\0') return false;
+			if (*pattern != '?' && *pattern != *path) return false;
+			if (*pattern == '?' && *path == '/') return false;
+
+			pattern++;
+			path++;
+		}
+
+		return *path == '\0';
+	}
+
+	//Compares numbers in names by value, so chapter2 goes before chapter10
+	bool natural_less(const std::string& a, const std::string& b)
+	{
+		size_t i = 0, j = 0;
+
+		while (i < a.size() && j < b.size())
+		{
+			if (std::isdigit(static_cast<unsigned char>(a[i])) && std::isdigit(static_cast<unsigned char>(b[j])))
+			{
+				size_t a_end = i, b_end = j;
+				while (a_end < a.size() && std::isdigit(static_cast<unsigned char>(a[a_end]))) a_end++;
+				while (b_end < b.size() && std::isdigit(static_cast<unsigned char>(b[b_end]))) b_end++;
+
+				//Without leading zeros, the longer number is bigger
+				size_t a_digits = a_end - i, b_digits = b_end - j;
+				while (a_digits > 1 && a[a_end - a_digits] == '0') a_digits--;
+				while (b_digits > 1 && b[b_end - b_digits] == '0') b_digits--;
+
+				if (a_digits != b_digits) return a_digits < b_digits;
+
+				int compared = a.compare(a_end - a_digits, a_digits, b, b_end - b_digits, b_digits);
+				if (compared != 0) return compared < 0;
+
+				i = a_end;
+				j = b_end;
+				continue;
+			}
+
+			if (a[i] != b[j]) return a[i] < b[j];
+			i++;
+			j++;
+		}
+
+		return a.size() - i < b.size() - j;
+	}
+
+	//Listing of the directory from the cache, read again only if its modification time changed
+	directory_listing get_directory_listing(generator_state& generator, const std::filesystem::path& path)
+	{
+		std::error_code error;
+		std::string key = path.lexically_normal().generic_string();
+
+		auto time = std::filesystem::last_write_time(path, error);
+		if (error) return {};
+
+		long long modification_time = static_cast<long long>(time.time_since_epoch().count());
+
+		{
+			std::lock_guard<std::mutex> lock(generator.directories.mutex);
+
+			auto found = generator.directories.listings.find(key);
+			if (found != generator.directories.listings.end() && found->second.modification_time == modification_time)
+				return found->second;
+		}
+
+		directory_listing listing;
+		listing.modification_time = modification_time;
+
+		for (auto itr = std::filesystem::directory_iterator(path, error); !error && itr != std::filesystem::directory_iterator(); itr.increment(error))
+		{
+			std::string name = itr->path().filename().string();
+			if (name.empty() || name[0] == '.') continue;
+
+			//Links to directories could make a loop
+			if (itr->is_symlink(error)) continue;
+
+			if (itr->is_directory(error))
+				listing.directories.push_back(name);
+			else if (itr->is_regular_file(error))
+				listing.files.push_back(name);
+		}
+
+		std::sort(listing.files.begin(), listing.files.end());
+		std::sort(listing.directories.begin(), listing.directories.end());
+
+		{
+			std::lock_guard<std::mutex> lock(generator.directories.mutex);
+			generator.directories.listings[key] = listing;
+		}
+
+		return listing;
+	}
+
+	//Lists the whole tree, every directory on a separate task
+	//key	: directory relative to root, "" for the root
+	std::map<std::string, directory_listing> scan_directory_tree(generator_state& generator, const std::filesystem::path& root)
+	{
+		std::map<std::string, directory_listing> listings;
+		std::mutex listings_mutex;
+
+		worker_pool::task_group scan_group;
+
+		std::function<void(const std::string&)> scan = [&](const std::string& relative)
+		{
+			auto listing = get_directory_listing(generator, relative.empty() ? root : root / relative);
+
+			for (auto& directory : listing.directories)
+			{
+				std::string subdirectory = relative.empty() ? directory : relative + "/" + directory;
+				generator.pool.submit(scan_group, [&scan, subdirectory]() { scan(subdirectory); });
+			}
+
+			std::lock_guard<std::mutex> lock(listings_mutex);
+			listings[relative] = std::move(listing);
+		};
+
+		generator.pool.submit(scan_group, [&scan]() { scan(""); });
+		generator.pool.wait(scan_group);
+
+		return listings;
+	}
+
+	//File or subdirectory of an expanded directory
+	struct expanded_item
+	{
+		//Name used for sorting, without the extension for files
+		std::string key;
+
+		//Page file relative to the project folder, empty for directories
+		std::string file;
+
+		//Directory relative to the project folder with a / at the end, empty for files
+		std::string directory;
+
+		std::vector<expanded_item> children;
+	};
+
+	std::vector<expanded_item> expand_directory(
+		const std::map<std::string, directory_listing>& listings,
+		const std::string& relative,
+		const std::string& dir,
+		const std::string& glob,
+		bool natural_sort
+	)
+	{
+		std::vector<expanded_item> items;
+
+		auto listing = listings.find(relative);
+		if (listing == listings.end()) return items;
+
+		std::string prefix = relative.empty() ? "" : relative + "/";
+
+		for (auto& file : listing->second.files)
+			if (glob_match(glob.c_str(), (prefix + file).c_str()))
+				items.push_back({ remove_file_extension(file), dir + prefix + file, "", {} });
+
+		for (auto& directory : listing->second.directories)
+		{
+			auto children = expand_directory(listings, prefix + directory, dir, glob, natural_sort);
+			if (!children.empty())
+				items.push_back({ directory, "", dir + prefix + directory + "/", std::move(children) });
+		}
+
+		//Files go before the directories with the same name, which they are the section pages of
+		std::stable_sort(items.begin(), items.end(), [&](const expanded_item& a, const expanded_item& b)
+		{
+			if (a.key == b.key) return !a.file.empty() && b.file.empty();
+			return natural_sort ? natural_less(a.key, b.key) : a.key < b.key;
+		});
+
+		return items;
+	}
+
+	bool is_section_page(const std::vector<expanded_item>& items, size_t i)
+	{
+		return !items.at(i).file.empty() && i + 1 < items.size() && items.at(i + 1).file.empty() && items.at(i + 1).key == items.at(i).key;
+	}
+
+	//Pages nested in a section are saved in the section's folder, so their names leave out the section's directory
+	//name_prefix	: directory of the section the pages are in, empty for the top level, whose names are whole paths
+	void add_expanded_page(std::vector<page_order_node>& pages_order, const std::string& file, const std::string& name_prefix)
+	{
+		add_page_node(pages_order, file);
+
+		if (name_prefix.empty() || file.compare(0, name_prefix.size(), name_prefix) != 0) return;
+
+		auto& node = pages_order.back();
+		node.page_name = remove_file_extension(file.substr(name_prefix.size()));
+		node.page_name_undescores = node.page_name;
+
+		replace_spaces_with_underscores(node.page_name_undescores);
+	}
+
+	//Section page taken from the directory's own pages, named like the directory so its pages are saved in it
+	void add_directory_section_page(std::vector<page_order_node>& pages_order, const std::string& file, const std::string& directory, const std::string& name_prefix)
+	{
+		add_page_node(pages_order, file);
+
+		auto& node = pages_order.back();
+		node.page_name = directory.substr(name_prefix.size(), directory.size() - name_prefix.size() - 1);
+		node.page_name_undescores = node.page_name;
+
+		replace_spaces_with_underscores(node.page_name_undescores);
+	}
+
+	void add_expanded_items(std::vector<page_order_node>& pages_order, std::vector<expanded_item>& items, const std::string& name_prefix)
+	{
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			auto& item = items.at(i);
+
+			if (!item.file.empty())
+			{
+				add_expanded_page(pages_order, item.file, name_prefix);
+
+				if (is_section_page(items, i))
+				{
+					pages_order.push_back({});
+					pages_order.back().is_go_down = true;
+
+					auto& directory = items.at(++i);
+					add_expanded_items(pages_order, directory.children, directory.directory);
+
+					pages_order.push_back({});
+					pages_order.back().is_go_up = true;
+				}
+
+				continue;
+			}
+
+			//Directory without a page next to it, one of its own pages becomes the section page
+			auto& children = item.children;
+			size_t section_page = children.size();
+
+			for (size_t j = 0; j < children.size(); j++)
+				if (children.at(j).key == "index" && !is_section_page(children, j))
+				{
+					section_page = j;
+					break;
+				}
+
+			for (size_t j = 0; j < children.size() && section_page == children.size(); j++)
+				if (!children.at(j).file.empty() && !is_section_page(children, j))
+					section_page = j;
+
+			if (section_page == children.size())
+			{
+				add_expanded_items(pages_order, children, name_prefix);
+				continue;
+			}
+
+			add_directory_section_page(pages_order, children.at(section_page).file, item.directory, name_prefix);
+			children.erase(children.begin() + section_page);
+
+			pages_order.push_back({});
+			pages_order.back().is_go_down = true;
+
+			add_expanded_items(pages_order, children, item.directory);
+
+			pages_order.push_back({});
+			pages_order.back().is_go_up = true;
+		}
+	}
+
+	bool expand_directory_entry(
+		std::vector<page_order_node>& pages_order,
+		const nlohmann::json& entry,
+		directory_scan* scan
+	)
+	{
+		if (scan == nullptr || !entry.contains("dir")) return false;
+
+		std::string dir = entry.at("dir").get<std::string>();
+		std::string glob = entry.contains("glob") ? entry.at("glob").get<std::string>() : "**/*.md";
+		std::string sort = entry.contains("sort") ? entry.at("sort").get<std::string>() : "name";
+
+		if (sort != "name" && sort != "natural") return false;
+
+		//Page files are relative to the project folder, like the ones listed by hand
+		dir = std::filesystem::path(dir).lexically_normal().generic_string();
+		if (dir == ".") dir.clear();
+		if (!dir.empty() && dir.back() != '/') dir += '/';
+		if (dir.rfind("..", 0) == 0 || (!dir.empty() && dir[0] == '/')) return false;
+
+		auto root = std::filesystem::path(scan->project_folder) / dir;
+
+		std::error_code error;
+		if (!std::filesystem::is_directory(root, error))
+		{
+			if (scan->message) scan->message("Error: Directory \"" + dir + "\" of pages order doesn't exist");
+			return false;
+		}
+
+		auto listings = scan_directory_tree(scan->generator, root);
+
+		auto items = expand_directory(listings, "", dir, glob, sort == "natural");
+		if (items.empty() && scan->message) scan->message("[Warning] Directory \"" + dir + "\" of pages order has no pages matching \"" + glob + "\"");
+
+		add_expanded_items(pages_order, items, "");
+
+		return true;
+	}
+
+	void save_directory_cache(generator_state& generator, std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(generator.directories.mutex);
+
+		for (auto& listing : generator.directories.listings)
+		{
+			out << "D " << listing.second.modification_time << ' ' << listing.first << '\n';
+
+			for (auto& file : listing.second.files)
+				out << "f " << file << '\n';
+
+			for (auto& directory : listing.second.directories)
+				out << "d " << directory << '\n';
+		}
+	}
+
+	void load_directory_cache(generator_state& generator, std::istream& in)
+	{
+		std::lock_guard<std::mutex> lock(generator.directories.mutex);
+
+		directory_listing* listing = nullptr;
+		std::string line;
+
+		while (std::getline(in, line))
+		{
+			if (line.size() < 2 || line[1] != ' ') continue;
+
+			if (line[0] == 'D')
+			{
+				size_t time_end = line.find(' ', 2);
+				if (time_end == std::string::npos) { listing = nullptr; continue; }
+
+				long long modification_time = 0;
+				try { modification_time = std::stoll(line.substr(2, time_end - 2)); }
+				catch (const std::exception&) { listing = nullptr; continue; }
+
+				listing = &generator.directories.listings[line.substr(time_end + 1)];
+				*listing = {};
+				listing->modification_time = modification_time;
+			}
+			else if (listing != nullptr && line[0] == 'f')
+				listing->files.push_back(line.substr(2));
+			else if (listing != nullptr && line[0] == 'd')
+				listing->directories.push_back(line.substr(2));
+		}
+	}
+}
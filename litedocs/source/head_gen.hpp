@@ -45,6 +45,7 @@ const std::string litedocs_internal::head_format = R"(
     <meta charset="UTF-8">
     <meta name="viewport" content="width=device-width, initial-scale=1.0">
     <title>{}</title>
+    <link rel="stylesheet" href="/highlighting.css">
     <style>
         body {
             margin: 0;
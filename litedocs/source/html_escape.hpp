@@ -0,0 +1,206 @@
+#pragma once
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define LITEDOCS_ESCAPE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define LITEDOCS_ESCAPE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+	#define LITEDOCS_ESCAPE_NEON
+#endif
+
+#if defined(_MSC_VER) && (defined(LITEDOCS_ESCAPE_AVX2) || defined(LITEDOCS_ESCAPE_SSE2))
+	#include <intrin.h>
+#endif
+
+namespace litedocs_internal
+{
+	inline bool is_html_special(char c)
+	{
+		return c == '<' || c == '>' || c == '&';
+	}
+
+#if defined(LITEDOCS_ESCAPE_AVX2) || defined(LITEDOCS_ESCAPE_SSE2)
+	inline size_t count_trailing_zeros(unsigned int mask)
+	{
+	#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+	#else
+		return __builtin_ctz(mask);
+	#endif
+	}
+#endif
+
+#if defined(LITEDOCS_ESCAPE_AVX2)
+	constexpr size_t html_escape_chunk = 32;
+
+	//Bit for every <, > and & in the 32 bytes
+	inline unsigned int html_special_mask(const char* data)
+	{
+		const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+		const __m256i special = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('<')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('>'))),
+			_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('&'))
+		);
+
+		return static_cast<unsigned int>(_mm256_movemask_epi8(special));
+	}
+#elif defined(LITEDOCS_ESCAPE_SSE2)
+	constexpr size_t html_escape_chunk = 16;
+
+	//Bit for every <, > and & in the 16 bytes
+	inline unsigned int html_special_mask(const char* data)
+	{
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+		const __m128i special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('<')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('>'))),
+			_mm_cmpeq_epi8(chunk, _mm_set1_epi8('&'))
+		);
+
+		return static_cast<unsigned int>(_mm_movemask_epi8(special));
+	}
+#elif defined(LITEDOCS_ESCAPE_NEON)
+	constexpr size_t html_escape_chunk = 16;
+
+	//Whether any of the 16 bytes is <, > or &; arm has no movemask, so the position is found one by one
+	inline bool html_special_any(const char* data)
+	{
+		const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(data));
+		const uint8x16_t special = vorrq_u8(
+			vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('<')), vceqq_u8(chunk, vdupq_n_u8('>'))),
+			vceqq_u8(chunk, vdupq_n_u8('&'))
+		);
+
+		return vmaxvq_u8(special) != 0;
+	}
+#endif
+
+	//Whether there are no <, > and & in the text, checked 4 chunks at once
+	inline bool html_clean_block(const char* data, size_t size)
+	{
+		size_t i = 0;
+
+#if defined(LITEDOCS_ESCAPE_AVX2) || defined(LITEDOCS_ESCAPE_SSE2)
+		for (; i + 4 * html_escape_chunk <= size; i += 4 * html_escape_chunk)
+		{
+			unsigned int mask = html_special_mask(data + i) | html_special_mask(data + i + html_escape_chunk)
+				| html_special_mask(data + i + 2 * html_escape_chunk) | html_special_mask(data + i + 3 * html_escape_chunk);
+
+			if (mask != 0) return false;
+		}
+#elif defined(LITEDOCS_ESCAPE_NEON)
+		for (; i + html_escape_chunk <= size; i += html_escape_chunk)
+			if (html_special_any(data + i)) return false;
+#endif
+
+		for (; i < size; i++)
+			if (is_html_special(data[i])) return false;
+
+		return true;
+	}
+
+	//Padded to 8 bytes, so every entity is stored with one move
+	alignas(8) constexpr char html_entities[3][8] = { "&lt;", "&gt;", "&amp;" };
+
+	//Writes 8 bytes, the ones after the entity are overwritten by the next store
+	inline char* write_html_entity(char* target, char c)
+	{
+		size_t index = (c == '>') + 2 * (c == '&');
+
+		std::memcpy(target, html_entities[index], 8);
+		return target + 4 + (c == '&');
+	}
+
+	//Text escaped at once, written to a buffer of the thread which stays in the cache
+	constexpr size_t html_escape_block = 4096;
+
+	//Bytes of the longest entity, &amp;
+	constexpr size_t html_entity_size = 5;
+
+	//Room for a chunk or an entity stored past the end of the escaped block
+#if defined(LITEDOCS_ESCAPE_AVX2) || defined(LITEDOCS_ESCAPE_SSE2)
+	constexpr size_t html_escape_slack = html_escape_chunk;
+#else
+	constexpr size_t html_escape_slack = 8;
+#endif
+
+	//Appends text with <, > and & replaced by entities
+	//Blocks without them are appended straight from the text, the others are escaped in one pass to a buffer
+	//with room for the worst case, whole chunks at once, and appended from there; the output only grows by the escaped size
+	inline void append_html_escaped(std::string& out, const char* data, size_t size)
+	{
+		thread_local std::unique_ptr<char[]> buffer(new char[html_escape_block * html_entity_size + html_escape_slack]);
+
+		for (size_t i = 0; i < size; )
+		{
+			size_t block_end = i + std::min(size - i, html_escape_block);
+
+			if (html_clean_block(data + i, block_end - i))
+			{
+				out.append(data + i, block_end - i);
+				i = block_end;
+				continue;
+			}
+
+			char* target = buffer.get();
+
+#if defined(LITEDOCS_ESCAPE_AVX2) || defined(LITEDOCS_ESCAPE_SSE2)
+			//Stores of the bytes after a special one read a whole chunk, which has to be in the text
+			for (; i + html_escape_chunk <= block_end && i + 2 * html_escape_chunk <= size; i += html_escape_chunk)
+			{
+				unsigned int mask = html_special_mask(data + i);
+
+				std::memcpy(target, data + i, html_escape_chunk);
+
+				if (mask == 0)
+				{
+					target += html_escape_chunk;
+					continue;
+				}
+
+				size_t copied = 0;
+
+				for (; mask != 0; mask &= mask - 1)
+				{
+					size_t special = count_trailing_zeros(mask);
+
+					target += special - copied;
+					target = write_html_entity(target, data[i + special]);
+					copied = special + 1;
+
+					std::memcpy(target, data + i + copied, html_escape_chunk);
+				}
+
+				target += html_escape_chunk - copied;
+			}
+#elif defined(LITEDOCS_ESCAPE_NEON)
+			for (; i + html_escape_chunk <= block_end && !html_special_any(data + i); i += html_escape_chunk)
+			{
+				std::memcpy(target, data + i, html_escape_chunk);
+				target += html_escape_chunk;
+			}
+#endif
+
+			for (; i < block_end; i++)
+			{
+				char c = data[i];
+
+				if (is_html_special(c))
+					target = write_html_entity(target, c);
+				else
+					*target++ = c;
+			}
+
+			out.append(buffer.get(), target - buffer.get());
+		}
+	}
+
+	inline void append_html_escaped(std::string& out, const std::string& text)
+	{
+		append_html_escaped(out, text.data(), text.size());
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	extern const std::string navigation_script;
+
+	//Attributes of the content div, telling the navigation script which pages to prefetch
+	void generate_navigation_attributes(std::string& attributes, const std::string& previous_link, const std::string& next_link)
+	{
+		attributes.clear();
+
+		if (!previous_link.empty())
+			attributes += " data-prev=\"" + previous_link + "\"";
+
+		if (!next_link.empty())
+			attributes += " data-next=\"" + next_link + "\"";
+	}
+}
+
+/*
+	Swaps the content div with the page's .fragment.html instead of loading the whole page
+	Prefetches the previous and next page, falls back to normal navigation if a fragment fails to load
+*/
+const std::string litedocs_internal::navigation_script = R"(
+	<!-- Generate Navigation -->
+	<script>
+	(function () {
+		var fragments = {};
+
+		function fetch_fragment(url) {
+			if (!(url in fragments))
+				fragments[url] = fetch(url.replace(/\.html$/, ".fragment.html")).then(function (response) {
+					if (!response.ok) throw new Error(response.status);
+					return response.text();
+				});
+			return fragments[url];
+		}
+
+		function prefetch_neighbours() {
+			var content = document.querySelector(".content");
+			["data-prev", "data-next"].forEach(function (attribute) {
+				var url = content.getAttribute(attribute);
+				if (url) fetch_fragment(url).catch(function () { delete fragments[url]; });
+			});
+		}
+
+		function show(url, push) {
+			fetch_fragment(url).then(function (html) {
+				var holder = document.createElement("div");
+				holder.innerHTML = html;
+
+				var content = holder.querySelector(".content");
+				document.querySelector(".content").replaceWith(content);
+
+				if (push) history.pushState(null, "", url);
+				content.scrollTop = 0;
+
+				prefetch_neighbours();
+			}).catch(function () {
+				location.href = url;
+			});
+		}
+
+		document.addEventListener("click", function (event) {
+			var link = event.target.closest("a");
+			if (!link || event.button !== 0 || event.ctrlKey || event.metaKey || event.shiftKey) return;
+
+			var url = link.getAttribute("href");
+			if (!url || url.charAt(0) !== "/" || !/\.html$/.test(url)) return;
+
+			event.preventDefault();
+			if (url !== location.pathname) show(url, true);
+		});
+
+		window.addEventListener("popstate", function () {
+			show(location.pathname, false);
+		});
+
+		prefetch_neighbours();
+	})();
+	</script>
+)";
@@ -0,0 +1,111 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	extern const std::string service_worker_registration;
+	extern const std::string service_worker_script;
+
+	//File the service worker keeps in the cache, refetched when its hash changes
+	struct precache_entry
+	{
+		//Absolute url, like the links between pages
+		std::string url;
+		std::string hash;
+	};
+
+	void generate_precache_manifest(std::string& manifest, std::vector<precache_entry> entries)
+	{
+		std::sort(entries.begin(), entries.end(), [](const precache_entry& a, const precache_entry& b) { return a.url < b.url; });
+
+		manifest = "[\n";
+
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			std::string url;
+			for (char c : entries.at(i).url)
+			{
+				if (c == '"' || c == '\\') url += '\\';
+				url += c;
+			}
+
+			manifest += "\t{ \"url\": \"" + url + "\", \"hash\": \"" + entries.at(i).hash + "\" }";
+			manifest += i + 1 != entries.size() ? ",\n" : "\n";
+		}
+
+		manifest += "]\n";
+	}
+
+	//The manifest is a part of the script, so the browser installs the new worker whenever a hash changes
+	void generate_service_worker(std::string& service_worker, const std::string& manifest)
+	{
+		service_worker = "var precache_manifest = " + manifest + ";\n" + service_worker_script;
+	}
+}
+
+const std::string litedocs_internal::service_worker_registration = R"(
+	<!-- Generate Service Worker Registration -->
+	<script>
+	if ("serviceWorker" in navigator)
+		navigator.serviceWorker.register("/service-worker.js");
+	</script>
+)";
+
+/*
+	Every file is cached under its url with the hash as query, so after a deploy
+	only the files with a new hash are fetched and the rest stays in the cache
+*/
+const std::string litedocs_internal::service_worker_script = R"(
+var cache_name = "litedocs";
+var cached_urls = {};
+
+precache_manifest.forEach(function (entry) {
+	var url = encodeURI(entry.url);
+	cached_urls[url] = url + "?litedocs=" + entry.hash;
+});
+
+self.addEventListener("install", function (event) {
+	event.waitUntil(caches.open(cache_name).then(function (cache) {
+		return Promise.all(Object.keys(cached_urls).map(function (url) {
+			var key = cached_urls[url];
+			return cache.match(key).then(function (cached) {
+				if (cached) return;
+				return fetch(url, { cache: "reload" }).then(function (response) {
+					if (response.ok) return cache.put(key, response);
+				});
+			});
+		}));
+	}).then(function () {
+		return self.skipWaiting();
+	}));
+});
+
+self.addEventListener("activate", function (event) {
+	var current_keys = {};
+	Object.keys(cached_urls).forEach(function (url) {
+		current_keys[new URL(cached_urls[url], self.location.origin).href] = true;
+	});
+
+	event.waitUntil(caches.open(cache_name).then(function (cache) {
+		return cache.keys().then(function (requests) {
+			return Promise.all(requests.map(function (request) {
+				if (!current_keys[request.url]) return cache.delete(request);
+			}));
+		});
+	}).then(function () {
+		return self.clients.claim();
+	}));
+});
+
+self.addEventListener("fetch", function (event) {
+	if (event.request.method !== "GET") return;
+
+	var url = new URL(event.request.url);
+	if (url.origin !== self.location.origin || !(url.pathname in cached_urls)) return;
+
+	event.respondWith(caches.open(cache_name).then(function (cache) {
+		return cache.match(cached_urls[url.pathname]).then(function (cached) {
+			return cached || fetch(event.request);
+		});
+	}));
+});
+)";
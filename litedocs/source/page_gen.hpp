@@ -0,0 +1,687 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	struct page_job
+	{
+		//Position in the project's page tree
+		size_t index = 0;
+		const page_order_node* page = nullptr;
+
+		//Project folder and page file, for messages
+		std::string source_path;
+
+		std::string content_attributes;
+
+		//Filled while rendering
+		std::vector<std::string> links;
+		std::set<std::string> languages;
+		std::vector<std::string> includes;
+
+		//Filled while saving, for the precache manifest and shard manifests
+		std::string content_hash;
+		std::string fragment_hash;
+		std::vector<std::string> part_hashes;
+
+		//Spent rendering and saving the page
+		long long microseconds = 0;
+	};
+
+	struct project_job
+	{
+		std::string folder;
+		litedocs_internal::project project;
+
+		std::string head;
+		std::string navbar;
+		std::string sidebar;
+
+		std::vector<page_job> pages;
+		std::atomic<bool> failed{ false };
+
+		litedocs::load_file_callback load_file = nullptr;
+		litedocs::message_callback message = nullptr;
+
+		//Hash saved files, set for offline projects and shards
+		bool hash_pages = false;
+
+		//Snippets included by the project's pages, so every file is loaded once
+		//key	: file, relative to the project folder
+		//value : nullptr if it failed to load
+		std::map<std::string, std::shared_ptr<snippet>> snippets;
+		std::mutex snippets_mutex;
+	};
+
+	bool load_project_job(
+		generator_state& generator,
+		project_job& job,
+		const std::string& project_file_filepath,
+		litedocs::load_file_callback load_file,
+		litedocs::message_callback message
+	)
+	{
+		/*
+			Load project
+		*/
+
+		std::string project_filename;
+
+		{
+			size_t found;
+			found = project_file_filepath.find_last_of("/\\");
+
+			job.folder = project_file_filepath.substr(0, found);
+			project_filename = project_file_filepath.substr(found + 1);
+		}
+
+		litedocs::loaded_file project_file = load_file(project_filename, job.folder);
+		throw_error(!project_file.success, "[Error] Missing project file");
+
+		nlohmann::json project_json;
+		try
+		{
+			project_json = nlohmann::json::parse(project_file.content);
+		}
+		catch (const std::exception& exc)
+		{
+			message("[Error] " + std::string(exc.what()));
+			message("[Error] Failed to load project");
+			return false;
+		}
+		
+		directory_scan scan{ generator, job.folder, message };
+		throw_error(!read_project(job.project, project_json, message, &scan), "[Error] Failed to load project");
+
+		job.load_file = load_file;
+		job.message = message;
+		job.hash_pages = job.project.offline;
+
+		/*
+			Generate Head, Navbar and Sidebar
+		*/
+
+		generate_unclosed_head(job.head, job.project);
+		if (job.project.offline)
+			job.head += service_worker_registration;
+		generate_navbar(job.navbar, job.project);
+		generate_sidebar(job.sidebar, job.project);
+
+		/*
+			List the pages
+		*/
+
+		const auto& tree = job.project.tree;
+
+		for (size_t i = 0; i < tree.size(); i++)
+		{
+			job.pages.push_back({});
+			job.pages.back().index = i;
+			job.pages.back().page = &job.project.pages_order.at(tree.node.at(i));
+			job.pages.back().source_path = job.folder + "/" + job.pages.back().page->file;
+		}
+
+		//Neighbours in pages order, for prefetching
+		if (job.project.fragments)
+			for (size_t i = 0; i < tree.size(); i++)
+				generate_navigation_attributes(
+					job.pages.at(i).content_attributes,
+					tree.previous.at(i) != page_tree::none ? tree.link.at(tree.previous.at(i)) : "",
+					tree.next.at(i) != page_tree::none ? tree.link.at(tree.next.at(i)) : ""
+				);
+
+		return true;
+	}
+
+	//Page going through the load, render and save stages
+	struct page_work
+	{
+		//Position in the order pages are saved in, with ordered output
+		size_t sequence = 0;
+
+		project_job* project = nullptr;
+		page_job* page = nullptr;
+
+		litedocs::loaded_file source;
+
+		//Streamed pages render while saving, so html and fragment stay empty
+		bool streamed = false;
+
+		std::unique_ptr<std::string> html;
+		std::unique_ptr<std::string> fragment;
+
+		//Code blocks highlighted on the worker pool after the markdown pass, when collecting is on
+		bool defer_highlighting = false;
+		std::vector<deferred_highlight> deferred;
+
+		//Content after the first part of a split page
+		std::vector<std::string> parts;
+
+		//Included snippets, in the order of their placeholders
+		std::vector<std::shared_ptr<snippet>> snippets;
+
+		//Rendered alone as one document, see preview.hpp: not streamed nor split, and snippets are read again
+		bool preview = false;
+	};
+
+	//reload	: skips the project's snippets, for previews of a snippet being edited
+	std::shared_ptr<snippet> get_project_snippet(generator_state& generator, project_job& job, const std::string& file, bool reload)
+	{
+		if (reload)
+		{
+			auto loaded = job.load_file(file, job.folder);
+			return loaded.success ? get_cached_snippet(generator, std::move(loaded.content)) : nullptr;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(job.snippets_mutex);
+
+			auto found = job.snippets.find(file);
+			if (found != job.snippets.end())
+				return found->second;
+		}
+
+		auto loaded = job.load_file(file, job.folder);
+
+		std::shared_ptr<snippet> result;
+		if (loaded.success)
+			result = get_cached_snippet(generator, std::move(loaded.content));
+
+		//Another page could have loaded it meanwhile
+		std::lock_guard<std::mutex> lock(job.snippets_mutex);
+		return job.snippets.insert({ file, result }).first->second;
+	}
+
+	//Replaces include lines of the page's markdown with placeholders, converting the snippets they include
+	void resolve_includes(generator_state& generator, page_work& work)
+	{
+		auto& content = work.source.content;
+		if (content.find("<!-- include ") == std::string::npos) return;
+
+		std::string resolved;
+		resolved.reserve(content.size());
+
+		size_t copied = 0;
+		size_t line_begin = 0;
+		char open_fence = 0;
+
+		while (line_begin < content.size())
+		{
+			size_t line_end = content.find('\n', line_begin);
+			if (line_end == std::string::npos) line_end = content.size();
+
+			char fence = get_code_fence(content, line_begin, line_end);
+			std::string file = open_fence == 0 ? get_include_directive(content, line_begin, line_end) : "";
+
+			if (open_fence != 0)
+			{
+				if (fence == open_fence) open_fence = 0;
+			}
+			else if (fence != 0)
+				open_fence = fence;
+
+			if (!file.empty())
+			{
+				resolved.append(content, copied, line_begin - copied);
+				copied = line_end;
+
+				work.page->includes.push_back(file);
+
+				auto included = get_project_snippet(generator, *work.project, file, work.preview);
+				if (included == nullptr)
+				{
+					if (work.project->message != nullptr)
+						work.project->message("[Warning] Missing snippet: " + file + " (included in " + work.page->page->file + ")");
+				}
+				else
+				{
+					convert_snippet(generator, *included);
+					work.page->languages.insert(included->languages.begin(), included->languages.end());
+
+					//A paragraph of its own
+					resolved += "\n" + snippet_placeholder(work.snippets.size()) + "\n";
+					work.snippets.push_back(std::move(included));
+				}
+			}
+
+			line_begin = line_end + 1;
+		}
+
+		resolved.append(content, copied, std::string::npos);
+		content.swap(resolved);
+
+		std::sort(work.page->includes.begin(), work.page->includes.end());
+		work.page->includes.erase(std::unique(work.page->includes.begin(), work.page->includes.end()), work.page->includes.end());
+	}
+
+	//Adds the time until the end of the scope to the page's time
+	struct page_timer
+	{
+		long long& microseconds;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+		~page_timer()
+		{
+			auto elapsed = std::chrono::steady_clock::now() - begin;
+			microseconds += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+		}
+	};
+
+	template<class output>
+	void write_page_content(generator_state& generator, page_work& work, output& out_stream, std::vector<std::string>& links)
+	{
+		litedocs_profile_allocations(markdown);
+
+		auto previous_context = current_render_context;
+		current_render_context = {
+			&generator,
+			&work.page->languages,
+			work.defer_highlighting ? &work.deferred : nullptr,
+			&work.page->source_path,
+			work.project->message
+		};
+
+		if (work.streamed)
+			generate_content_streamed(out_stream, work.source.content, work.page->content_attributes, generator.html_tags, links, work.snippets);
+		else
+			generate_content(out_stream, work.source.content, work.page->content_attributes, generator.html_tags, links, work.snippets);
+
+		current_render_context = previous_context;
+	}
+
+	template<class output, class content_writer>
+	void write_page_layout(const project_job& job, output& out_stream, content_writer write_content)
+	{
+		out_stream << job.head;
+
+		out_stream << "</head>";
+
+		out_stream << "<body bgcolor=" << job.project.content_background << " >";
+		out_stream << job.navbar;
+		out_stream << "<div class=\"main\">";
+		out_stream << job.sidebar;
+
+		write_content(out_stream);
+
+		out_stream << R"(</div>)";
+
+		if (job.project.fragments)
+			out_stream << navigation_script;
+
+		if (job.project.split_threshold != 0)
+			out_stream << split_script;
+
+		out_stream << R"(</body></html>)";
+	}
+
+	//Splits the content div, which is between content_begin and content_end of html, if it's over the threshold
+	void split_rendered_content(page_work& work, std::string& html, size_t content_begin, size_t content_end)
+	{
+		size_t threshold = work.project->project.split_threshold;
+		if (work.preview || threshold == 0 || content_end - content_begin <= threshold) return;
+
+		//Inside of the div, after its opening tag and before the closing tag which ends the content
+		const std::string opening_tag = "<div class=\"content\"";
+		const std::string closing_tag = "</div>";
+
+		size_t opening = html.find(opening_tag, content_begin);
+		size_t inner_begin = opening < content_end ? html.find('>', opening + opening_tag.size()) : std::string::npos;
+		size_t inner_end = content_end - content_begin >= closing_tag.size() ? html.rfind(closing_tag, content_end - closing_tag.size()) : std::string::npos;
+
+		if (inner_begin == std::string::npos || inner_end == std::string::npos || inner_end <= inner_begin) return;
+		inner_begin++;
+
+		//Saved as [page].part1.html, [page].part2.html and so on
+		std::string link_prefix = "/" + work.project->project.tree.output_path.at(work.page->index) + ".part";
+
+		split_page_content(html, inner_begin, inner_end, threshold, link_prefix, work.parts);
+	}
+
+	//Renders the loaded source to html, unless the page is streamed
+	//Placeholders are found by their control characters, so pages already containing them are highlighted in place
+	bool has_deferred_placeholder_characters(const page_work& work)
+	{
+		if (work.source.content.find('\x02') != std::string::npos) return true;
+
+		for (auto& included : work.snippets)
+			if (included->html.find('\x02') != std::string::npos)
+				return true;
+
+		return false;
+	}
+
+	void render_page(generator_state& generator, page_work& work)
+	{
+		const auto& project = work.project->project;
+
+		litedocs_profile_allocations_page(work.page->source_path);
+		litedocs_profile_allocations(assemble);
+
+		page_timer timer{ work.page->microseconds };
+
+		{
+			//Snippets are converted on the first page including them, with the context of that page
+			auto previous_context = current_render_context;
+			current_render_context.page = &work.page->source_path;
+			current_render_context.message = work.project->message;
+
+			resolve_includes(generator, work);
+
+			current_render_context = previous_context;
+		}
+
+		work.streamed = !work.preview && project.streaming_threshold != 0 && work.source.content.size() > project.streaming_threshold;
+		if (work.streamed) return;
+
+		//Long pages with many code blocks would otherwise keep one thread busy for the whole build
+		work.defer_highlighting = generator.pool.size() > 1 && !has_deferred_placeholder_characters(work);
+
+		work.html = generator.take_page_buffer();
+		string_output out_stream{ *work.html };
+
+		if (project.fragments)
+		{
+			work.fragment = generator.take_page_buffer();
+
+			string_output content_stream{ *work.fragment };
+			write_page_content(generator, work, content_stream, work.page->links);
+
+			if (!work.deferred.empty())
+			{
+				highlight_deferred(generator, work.deferred, work.page->source_path, work.project->message);
+				splice_deferred_highlights(generator, *work.fragment, 0, work.deferred);
+			}
+
+			split_rendered_content(work, *work.fragment, 0, work.fragment->size());
+
+			write_page_layout(*work.project, out_stream, [&](auto& out) { out << *work.fragment; });
+		}
+		else
+		{
+			size_t content_offset = 0;
+			size_t content_end = 0;
+
+			write_page_layout(*work.project, out_stream, [&](auto& out)
+			{
+				content_offset = work.html->size();
+				write_page_content(generator, work, out, work.page->links);
+				content_end = work.html->size();
+			});
+
+			//Counted from the end, splicing changes the size of the content
+			size_t after_content = work.html->size() - content_end;
+
+			if (!work.deferred.empty())
+			{
+				highlight_deferred(generator, work.deferred, work.page->source_path, work.project->message);
+				splice_deferred_highlights(generator, *work.html, content_offset, work.deferred);
+			}
+
+			split_rendered_content(work, *work.html, content_offset, work.html->size() - after_content);
+		}
+
+		work.deferred.clear();
+
+		//The markdown isn't needed anymore
+		work.source = {};
+		work.snippets.clear();
+	}
+
+	//Hashes what the writer writes, unless hash is nullptr
+	template<class writer>
+	void write_hashed(std::ostream& out_stream, std::string* hash, writer write)
+	{
+		if (hash == nullptr)
+		{
+			write(out_stream);
+			return;
+		}
+
+		hashing_streambuf hashing(out_stream.rdbuf());
+		std::ostream hashed_stream(&hashing);
+
+		write(hashed_stream);
+		*hash = hashing.hasher.digest();
+	}
+
+	//Writes the content to the page and to a spool file, which the fragment is copied from afterwards
+	template<class output>
+	struct tee_output
+	{
+		output& out;
+		std::FILE* spool;
+
+		tee_output& operator<<(const std::string& text)
+		{
+			out << text;
+			std::fwrite(text.data(), 1, text.size(), spool);
+			return *this;
+		}
+
+		tee_output& operator<<(const char* text) { return *this << std::string(text); }
+	};
+
+	//Converts the streamed page once, the fragment gets the same content from a temporary file
+	//Only one block is in memory at once, and the callback saves one file at a time as usual
+	void save_streamed_page_with_fragment(
+		generator_state& generator,
+		page_work& work,
+		litedocs::save_page_callback save_file,
+		litedocs::generated_page& gen_page,
+		litedocs::generated_page& fragment_page
+	)
+	{
+		auto& job = *work.project;
+		auto& page_job = *work.page;
+
+		std::unique_ptr<std::FILE, int(*)(std::FILE*)> spool(std::tmpfile(), &std::fclose);
+		bool page_written = false;
+
+		gen_page.write_content = [&](std::ostream& out_stream)
+		{
+			page_written = true;
+
+			write_hashed(out_stream, job.hash_pages ? &page_job.content_hash : nullptr, [&](std::ostream& out)
+			{
+				write_page_layout(job, out, [&](auto& content_out)
+				{
+					if (spool == nullptr)
+					{
+						write_page_content(generator, work, content_out, page_job.links);
+						return;
+					}
+
+					tee_output<std::remove_reference_t<decltype(content_out)>> tee{ content_out, spool.get() };
+					write_page_content(generator, work, tee, page_job.links);
+				});
+			});
+		};
+		save_file(&gen_page, job.folder);
+
+		bool spooled = page_written && spool != nullptr && std::fflush(spool.get()) == 0 && !std::ferror(spool.get());
+
+		fragment_page.write_content = [&](std::ostream& out_stream)
+		{
+			write_hashed(out_stream, job.hash_pages ? &page_job.fragment_hash : nullptr, [&](std::ostream& out)
+			{
+				//Converted again only without a spool file
+				if (!spooled)
+				{
+					std::vector<std::string> links_again;
+					write_page_content(generator, work, out, links_again);
+					return;
+				}
+
+				std::rewind(spool.get());
+
+				char buffer[64 * 1024];
+				size_t read;
+				while ((read = std::fread(buffer, 1, sizeof(buffer), spool.get())) != 0)
+					out.write(buffer, read);
+			});
+		};
+		save_file(&fragment_page, job.folder);
+	}
+
+	void save_rendered_page(generator_state& generator, page_work& work, litedocs::save_page_callback save_file)
+	{
+		auto& job = *work.project;
+		auto& page_job = *work.page;
+
+		litedocs_profile_allocations_page(page_job.source_path);
+		litedocs_profile_allocations(save);
+
+		page_timer timer{ page_job.microseconds };
+
+		litedocs::generated_page gen_page;
+		gen_page.page_name = page_job.page->page_name_undescores;
+		gen_page.sections = &job.project.tree.sections.at(page_job.index);
+		gen_page.includes = &page_job.includes;
+
+		litedocs::generated_page fragment_page;
+		fragment_page.page_name = page_job.page->page_name_undescores;
+		fragment_page.extension = ".fragment.html";
+		fragment_page.sections = &job.project.tree.sections.at(page_job.index);
+
+		if (work.streamed)
+		{
+			if (job.project.fragments)
+				save_streamed_page_with_fragment(generator, work, save_file, gen_page, fragment_page);
+			else
+			{
+				gen_page.write_content = [&](std::ostream& out_stream)
+				{
+					write_hashed(out_stream, job.hash_pages ? &page_job.content_hash : nullptr, [&](std::ostream& out)
+					{
+						write_page_layout(job, out, [&](auto& content_out) { write_page_content(generator, work, content_out, page_job.links); });
+					});
+				};
+				save_file(&gen_page, job.folder);
+			}
+
+			work.source = {};
+			work.snippets.clear();
+			return;
+		}
+
+		if (job.hash_pages)
+			page_job.content_hash = content_hash(*work.html);
+
+		gen_page.content = work.html.get();
+		save_file(&gen_page, job.folder);
+		generator.return_page_buffer(std::move(work.html));
+
+		if (work.fragment != nullptr)
+		{
+			if (job.hash_pages)
+				page_job.fragment_hash = content_hash(*work.fragment);
+
+			fragment_page.content = work.fragment.get();
+			save_file(&fragment_page, job.folder);
+			generator.return_page_buffer(std::move(work.fragment));
+		}
+
+		for (size_t i = 0; i < work.parts.size(); i++)
+		{
+			if (job.hash_pages)
+				page_job.part_hashes.push_back(content_hash(work.parts.at(i)));
+
+			litedocs::generated_page part_page;
+			part_page.page_name = page_job.page->page_name_undescores;
+			part_page.extension = ".part" + std::to_string(i + 1) + ".html";
+			part_page.sections = &job.project.tree.sections.at(page_job.index);
+			part_page.content = &work.parts.at(i);
+
+			save_file(&part_page, job.folder);
+		}
+
+		work.parts.clear();
+	}
+
+	void finish_project_job(
+		generator_state& generator,
+		project_job& job,
+		litedocs::load_file_callback load_file,
+		litedocs::save_page_callback save_file,
+		litedocs::message_callback message,
+		litedocs::save_asset_callback save_asset
+	)
+	{
+		std::vector<precache_entry> precache;
+
+		/*
+			Copy files referenced from the pages
+		*/
+
+		if (save_asset != nullptr)
+		{
+			asset_references assets;
+
+			for (auto& page : job.pages)
+				add_page_assets(assets, page.links, page.page->file, job.project.tree.output_path.at(page.index));
+
+			stage_assets(generator, assets, job.folder, load_file, save_asset, message, job.project.offline ? &precache : nullptr);
+		}
+
+		/*
+			Save colors of the highlighted code, shared by all pages
+		*/
+
+		std::set<std::string> languages;
+		for (auto& page : job.pages)
+			languages.insert(page.languages.begin(), page.languages.end());
+
+		std::string stylesheet;
+		generate_highlighting_stylesheet(generator, stylesheet, languages);
+
+		std::vector<const std::string*> root_sections;
+
+		litedocs::generated_page stylesheet_page;
+		stylesheet_page.page_name = "highlighting";
+		stylesheet_page.extension = ".css";
+		stylesheet_page.sections = &root_sections;
+		stylesheet_page.content = &stylesheet;
+
+		save_file(&stylesheet_page, job.folder);
+
+		/*
+			Service worker caching every saved file
+		*/
+
+		if (!job.project.offline) return;
+
+		precache.push_back({ "/highlighting.css", content_hash(stylesheet) });
+
+		for (auto& page : job.pages)
+		{
+			precache.push_back({ job.project.tree.link.at(page.index), page.content_hash });
+
+			if (job.project.fragments)
+				precache.push_back({ "/" + job.project.tree.output_path.at(page.index) + ".fragment.html", page.fragment_hash });
+
+			for (size_t i = 0; i < page.part_hashes.size(); i++)
+				precache.push_back({ "/" + job.project.tree.output_path.at(page.index) + ".part" + std::to_string(i + 1) + ".html", page.part_hashes.at(i) });
+		}
+
+		std::string manifest;
+		generate_precache_manifest(manifest, std::move(precache));
+
+		litedocs::generated_page manifest_page;
+		manifest_page.page_name = "precache-manifest";
+		manifest_page.extension = ".json";
+		manifest_page.sections = &root_sections;
+		manifest_page.content = &manifest;
+
+		save_file(&manifest_page, job.folder);
+
+		std::string service_worker;
+		generate_service_worker(service_worker, manifest);
+
+		litedocs::generated_page service_worker_page;
+		service_worker_page.page_name = "service-worker";
+		service_worker_page.extension = ".js";
+		service_worker_page.sections = &root_sections;
+		service_worker_page.content = &service_worker;
+
+		save_file(&service_worker_page, job.folder);
+	}
+}
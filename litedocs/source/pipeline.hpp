@@ -0,0 +1,266 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	/*
+		Pages go through three stages, so reading and writing files overlaps with rendering:
+		loading on the io threads, rendering on the worker pool and saving on the writer thread
+		At most pages_in_flight pages are between loading and saving at once
+	*/
+	//Runs a step outside of the pipeline, reporting an exception it throws instead of letting it out of the generator
+	template<class step>
+	bool run_reported(litedocs::message_callback message, step run)
+	{
+		try
+		{
+			return run();
+		}
+		catch (const std::exception& exc)
+		{
+			if (message != nullptr) message("[Error] " + std::string(exc.what()));
+		}
+		catch (...)
+		{
+			if (message != nullptr) message("[Error] Unknown exception");
+		}
+
+		return false;
+	}
+
+	struct pages_pipeline
+	{
+		generator_state& generator;
+		litedocs::load_file_callback load_file;
+		litedocs::save_page_callback save_file;
+		litedocs::message_callback message;
+
+		//Every page of every project, in the order of saving when output is ordered
+		std::vector<page_work> works;
+
+		size_t capacity = 0;
+		bool ordered = false;
+
+		//Streamed pages render while saving, let the workers save them instead of the writer
+		bool workers_save_streamed = false;
+
+		std::mutex mutex;
+		std::condition_variable changed;
+
+		size_t next_to_load = 0;
+		size_t in_flight = 0;
+		size_t loaders_running = 0;
+
+		//Pages done on the workers
+		//key	: sequence
+		//value : page, nullptr for pages which failed or were already saved
+		std::map<size_t, page_work*> finished;
+		size_t next_to_save = 0;
+
+		worker_pool::task_group render_group;
+
+		pages_pipeline(
+			generator_state& _generator,
+			litedocs::load_file_callback _load_file,
+			litedocs::save_page_callback _save_file,
+			litedocs::message_callback _message
+		) : generator(_generator), load_file(_load_file), save_file(_save_file), message(_message) {}
+
+		void run(std::vector<std::unique_ptr<project_job>>& jobs);
+
+	private:
+		void fail(page_work* work, const std::string& reason);
+		void finish(page_work* work, bool needs_saving);
+		void load();
+		void write();
+	};
+
+	void pages_pipeline::run(std::vector<std::unique_ptr<project_job>>& jobs)
+	{
+		//Projects are interleaved, so no project waits for the others to finish
+		size_t most_pages = 0;
+		for (auto& job : jobs)
+			most_pages = std::max(most_pages, job->pages.size());
+
+		for (size_t i = 0; i < most_pages; i++)
+			for (auto& job : jobs)
+			{
+				if (i >= job->pages.size()) continue;
+
+				works.push_back({});
+				works.back().sequence = works.size() - 1;
+				works.back().project = job.get();
+				works.back().page = &job->pages.at(i);
+			}
+
+		auto& settings = generator.settings;
+		size_t io_threads = std::max<size_t>(1, settings.io_threads);
+
+		capacity = settings.pages_in_flight != 0 ? settings.pages_in_flight : 2 * generator.pool.size() + io_threads;
+		ordered = settings.ordered_output;
+		workers_save_streamed = !ordered && generator.pool.size() > 1;
+
+		//Keeps the group from finishing before everything is loaded
+		generator.pool.hold(render_group);
+		loaders_running = io_threads;
+
+		std::vector<std::thread> loaders;
+		for (size_t i = 0; i < io_threads; i++)
+			loaders.emplace_back([this]() { load(); });
+
+		std::thread writer([this]() { write(); });
+
+		//Render here as well
+		generator.pool.wait(render_group);
+
+		for (auto& loader : loaders)
+			loader.join();
+		writer.join();
+	}
+
+	//For exceptions thrown while loading, rendering or saving the page; the other pages go on, the project fails
+	void pages_pipeline::fail(page_work* work, const std::string& reason)
+	{
+		if (message != nullptr) message("[Error] " + reason + " (in " + work->page->source_path + ")");
+		work->project->failed = true;
+	}
+
+	void pages_pipeline::finish(page_work* work, bool needs_saving)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finished[work->sequence] = needs_saving ? work : nullptr;
+		}
+		changed.notify_all();
+	}
+
+	void pages_pipeline::load()
+	{
+		while (true)
+		{
+			page_work* work;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [this]() { return next_to_load == works.size() || in_flight < capacity; });
+
+				if (next_to_load == works.size()) break;
+
+				//Taken in order together with the slot, so ordered saving can't wait on a page that can't load
+				work = &works.at(next_to_load++);
+				in_flight++;
+			}
+
+			auto& project = *work->project;
+
+			if (!project.failed)
+			{
+				litedocs_profile_allocations_page(work->page->source_path);
+				litedocs_profile_allocations(load);
+
+				bool threw = false;
+
+				try
+				{
+					work->source = load_file(work->page->page->file, project.folder);
+				}
+				catch (const std::exception& exc)
+				{
+					fail(work, exc.what());
+					threw = true;
+				}
+				catch (...)
+				{
+					fail(work, "Unknown exception");
+					threw = true;
+				}
+
+				if (!work->source.success && !threw)
+				{
+					if (message != nullptr) message("[Error] Failed to load file: " + work->page->page->file);
+					project.failed = true;
+				}
+			}
+
+			if (project.failed)
+			{
+				finish(work, false);
+				continue;
+			}
+
+			generator.pool.submit(render_group, [this, work]()
+			{
+				try
+				{
+					render_page(generator, *work);
+
+					if (work->streamed && workers_save_streamed)
+					{
+						save_rendered_page(generator, *work, save_file);
+						finish(work, false);
+					}
+					else finish(work, true);
+				}
+				catch (const std::exception& exc)
+				{
+					fail(work, exc.what());
+					finish(work, false);
+				}
+				catch (...)
+				{
+					fail(work, "Unknown exception");
+					finish(work, false);
+				}
+			});
+		}
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			last = --loaders_running == 0;
+		}
+
+		if (last)
+			generator.pool.release(render_group);
+	}
+
+	void pages_pipeline::write()
+	{
+		for (size_t saved = 0; saved < works.size(); saved++)
+		{
+			page_work* work;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [this]() { return ordered ? finished.count(next_to_save) != 0 : !finished.empty(); });
+
+				auto itr = ordered ? finished.find(next_to_save) : finished.begin();
+				work = itr->second;
+
+				finished.erase(itr);
+				next_to_save++;
+			}
+
+			if (work != nullptr)
+			{
+				try
+				{
+					save_rendered_page(generator, *work, save_file);
+				}
+				catch (const std::exception& exc)
+				{
+					fail(work, exc.what());
+				}
+				catch (...)
+				{
+					fail(work, "Unknown exception");
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				in_flight--;
+			}
+			changed.notify_all();
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	/*
+		Single pages of a loaded project, for previews while the page is edited
+		The project's head, navbar and sidebar are generated once when loading, only the content is rendered
+	*/
+
+	//Index of the page in the project's pages, the pages count if it's not in pages order
+	size_t find_project_page(const project_job& job, const std::string& page_file)
+	{
+		for (size_t i = 0; i < job.pages.size(); i++)
+			if (job.pages.at(i).page->file == page_file)
+				return i;
+
+		return job.pages.size();
+	}
+
+	//markdown	: rendered instead of the file's content if not nullptr, the page doesn't have to be in pages order then
+	//stylesheet	: gets the colors of the page's code blocks if not nullptr
+	bool render_preview(
+		generator_state& generator,
+		project_job& job,
+		const std::string& page_file,
+		const std::string* markdown,
+		std::string& html,
+		std::string* stylesheet
+	)
+	{
+		auto message = job.message;
+
+		//Copies, so previews of many pages can render at once
+		page_order_node detached_node;
+		page_job page;
+
+		size_t index = find_project_page(job, page_file);
+
+		if (index != job.pages.size())
+			page = job.pages.at(index);
+		else
+		{
+			throw_error(markdown == nullptr, "[Error] Page not in pages order: " + page_file);
+
+			fill_page_node(detached_node, page_file);
+			page.page = &detached_node;
+			page.source_path = job.folder + "/" + page_file;
+		}
+
+		page_work work;
+		work.project = &job;
+		work.page = &page;
+		work.preview = true;
+
+		if (markdown != nullptr)
+		{
+			work.source.content = *markdown;
+			work.source.success = true;
+		}
+		else
+		{
+			work.source = job.load_file(page_file, job.folder);
+			throw_error(!work.source.success, "[Error] Failed to load file: " + page_file);
+		}
+
+		render_page(generator, work);
+
+		html.swap(*work.html);
+		generator.return_page_buffer(std::move(work.html));
+
+		if (work.fragment != nullptr)
+			generator.return_page_buffer(std::move(work.fragment));
+
+		if (stylesheet != nullptr)
+			generate_highlighting_stylesheet(generator, *stylesheet, page.languages);
+
+		return true;
+	}
+}
@@ -12,6 +12,37 @@ namespace litedocs_internal
 		std::string page_name_undescores;	//page name but with spaces replaced with underscores
 	};
 
+	//Pages of pages order as a tree, every vector is indexed by the page's position among the pages
+	//Built once by read_project, so generators don't have to walk the go down / go up nodes
+	struct page_tree
+	{
+		static constexpr size_t none = static_cast<size_t>(-1);
+
+		//Index of the page's node in pages_order
+		std::vector<size_t> node;
+
+		std::vector<size_t> parent;
+		std::vector<size_t> first_child;
+		std::vector<size_t> next_sibling;
+
+		//Neighbours in pages order
+		std::vector<size_t> previous;
+		std::vector<size_t> next;
+
+		//Names of the sections the page is in, from the top, pointing into pages_order
+		std::vector<std::vector<const std::string*>> sections;
+
+		//Relative to the build folder, without the extension
+		std::vector<std::string> output_path;
+
+		//Absolute link to the page's .html file
+		std::vector<std::string> link;
+
+		size_t first_root = none;
+
+		size_t size() const { return node.size(); }
+	};
+
 	struct project
 	{
 		std::string name;
@@ -29,18 +60,141 @@ namespace litedocs_internal
 		std::string code_block_frame_color;
 		std::string code_block_background;
 
+		//Pages with more markdown bytes are converted block by block and streamed to the output, 0 disables
+		size_t streaming_threshold = 0;
+
+		//Save content-only fragments next to the pages, which the pages swap in without reloading
+		bool fragments = false;
+
+		//Save a service worker, which keeps every page and asset in the browser's cache for reading offline
+		bool offline = false;
+
+		//Pages with more bytes of content html are split at headings into parts loaded while scrolling, 0 disables
+		size_t split_threshold = 0;
+
 		std::vector<page_order_node> pages_order;
+		page_tree tree;
 	};
 
+	//Expands {"dir": ..., "glob": ..., "sort": ...} entries of pages order, see directory_scan.hpp
+	struct directory_scan;
+
 	bool recursive_get_pages_order(
 		std::vector<page_order_node>& pages_order,
-		nlohmann::json& pages
+		nlohmann::json& pages,
+		directory_scan* scan
 	);
 
+	bool expand_directory_entry(
+		std::vector<page_order_node>& pages_order,
+		const nlohmann::json& entry,
+		directory_scan* scan
+	);
+
+	void fill_page_node(page_order_node& node, const std::string& file)
+	{
+		node.file = file;
+		node.page_name = remove_file_extension(file);
+		node.page_name_undescores = node.page_name;
+
+		replace_spaces_with_underscores(node.page_name_undescores);
+	}
+
+	void add_page_node(std::vector<page_order_node>& pages_order, const std::string& file)
+	{
+		pages_order.push_back({});
+		fill_page_node(pages_order.back(), file);
+	}
+
+	void build_page_tree(project& project)
+	{
+		auto& tree = project.tree;
+		tree = {};
+
+		struct level
+		{
+			size_t parent;
+			size_t last_page;
+		};
+
+		std::vector<level> levels = { { page_tree::none, page_tree::none } };
+
+		//For every open subsection, whether it got its own level
+		//Subsections without a page before them (like the top one) stay in the enclosing level
+		std::vector<bool> opened_levels;
+
+		for (size_t i = 0; i < project.pages_order.size(); i++)
+		{
+			const auto& node = project.pages_order.at(i);
+
+			if (node.is_go_down)
+			{
+				bool after_page = i != 0 && !project.pages_order.at(i - 1).is_go_down && !project.pages_order.at(i - 1).is_go_up;
+
+				if (after_page)
+					levels.push_back({ levels.back().last_page, page_tree::none });
+
+				opened_levels.push_back(after_page);
+				continue;
+			}
+
+			if (node.is_go_up)
+			{
+				if (opened_levels.empty()) continue;
+
+				if (opened_levels.back())
+					levels.pop_back();
+
+				opened_levels.pop_back();
+				continue;
+			}
+
+			size_t page = tree.size();
+			size_t parent = levels.back().parent;
+
+			tree.node.push_back(i);
+			tree.parent.push_back(parent);
+			tree.first_child.push_back(page_tree::none);
+			tree.next_sibling.push_back(page_tree::none);
+			tree.previous.push_back(page == 0 ? page_tree::none : page - 1);
+			tree.next.push_back(page_tree::none);
+
+			if (page != 0)
+				tree.next.at(page - 1) = page;
+
+			if (levels.back().last_page != page_tree::none)
+				tree.next_sibling.at(levels.back().last_page) = page;
+			else if (parent != page_tree::none)
+				tree.first_child.at(parent) = page;
+			else
+				tree.first_root = page;
+
+			levels.back().last_page = page;
+
+			//Sections and path of the parent, followed by the parent itself
+			tree.sections.push_back({});
+			std::string output_path;
+
+			if (parent != page_tree::none)
+			{
+				tree.sections.back() = tree.sections.at(parent);
+				tree.sections.back().push_back(&project.pages_order.at(tree.node.at(parent)).page_name_undescores);
+
+				output_path = tree.output_path.at(parent) + "/";
+			}
+
+			output_path += node.page_name_undescores;
+
+			tree.link.push_back("/" + output_path + ".html");
+			tree.output_path.push_back(std::move(output_path));
+		}
+	}
+
 	bool read_project(
 		project& project,
 		const nlohmann::json& project_json,
-		litedocs::message_callback message
+		litedocs::message_callback message,
+		directory_scan* scan = nullptr
 	)
 	{
 		try
@@ -49,6 +203,18 @@ namespace litedocs_internal
 			project.name = project_json.at("name");
 			project.site_language_tag = project_json.at("site_language_tag");
 
+			if (project_json.contains("streaming_threshold"))
+				project.streaming_threshold = project_json.at("streaming_threshold").get<size_t>();
+
+			if (project_json.contains("fragments"))
+				project.fragments = project_json.at("fragments").get<bool>();
+
+			if (project_json.contains("offline"))
+				project.offline = project_json.at("offline").get<bool>();
+
+			if (project_json.contains("split_threshold"))
+				project.split_threshold = project_json.at("split_threshold").get<size_t>();
+
 			//Style
 			auto style = project_json.at("style");
 
@@ -80,7 +246,9 @@ namespace litedocs_internal
 			auto pages = project_json.at("pages_order");
 			if (!pages.is_array()) { message("Error: Pages order is supposed to be an array"); return false; }
 
-			if (!recursive_get_pages_order(project.pages_order, pages)) { message("Error: Invalid pages order"); return false; };
+			if (!recursive_get_pages_order(project.pages_order, pages, scan)) { message("Error: Invalid pages order"); return false; };
+
+			build_page_tree(project);
 		}
 		catch (const std::exception& exc)
 		{
@@ -93,25 +261,26 @@ namespace litedocs_internal
 
 	bool recursive_get_pages_order(
 		std::vector<page_order_node>& pages_order,
-		nlohmann::json& pages
+		nlohmann::json& pages,
+		directory_scan* scan
 	)
 	{
-		pages_order.push_back({});
-
 		if (pages.is_string())
 		{
-			pages_order.back().file = pages;
-			pages_order.back().page_name = remove_file_extension(pages);
-			pages_order.back().page_name_undescores = pages_order.back().page_name;
-
-			replace_spaces_with_underscores(pages_order.back().page_name_undescores);
+			add_page_node(pages_order, pages.get<std::string>());
+		}
+		else if (pages.is_object())
+		{
+			return expand_directory_entry(pages_order, pages, scan);
 		}
 		else if (pages.is_array())
 		{
+			pages_order.push_back({});
 			pages_order.back().is_go_down = true;
 
 			for (auto& page : pages)
-				recursive_get_pages_order(pages_order, page);
+				if (!recursive_get_pages_order(pages_order, page, scan))
+					return false;
 
 			pages_order.push_back({});
 			pages_order.back().is_go_up = true;
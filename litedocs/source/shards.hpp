@@ -0,0 +1,225 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	/*
+		Builds split across processes: every shard renders some of the pages and writes a manifest,
+		merging reads the manifests and saves what needs all pages, like highlighting.css and the precache manifest
+		Pages are given to shards by the size of their files, the same sources always give the same shards
+	*/
+
+	//Shard of every page of the project, by position in the project's pages
+	std::vector<size_t> assign_shard_pages(const project_job& job, size_t shard_count)
+	{
+		std::vector<size_t> weights;
+		std::vector<size_t> by_weight;
+
+		for (size_t i = 0; i < job.pages.size(); i++)
+		{
+			std::error_code error;
+			size_t size = static_cast<size_t>(std::filesystem::file_size(job.pages.at(i).source_path, error));
+
+			//Missing files still cost something, they fail on the shard which gets them
+			weights.push_back(error ? 1 : size + 1);
+			by_weight.push_back(i);
+		}
+
+		std::stable_sort(by_weight.begin(), by_weight.end(), [&](size_t a, size_t b) { return weights.at(a) > weights.at(b); });
+
+		//Biggest pages first, each to the least loaded shard
+		std::vector<size_t> loads(shard_count, 0);
+		std::vector<size_t> shards(job.pages.size(), 0);
+
+		for (size_t page : by_weight)
+		{
+			size_t lightest = std::min_element(loads.begin(), loads.end()) - loads.begin();
+
+			shards.at(page) = lightest;
+			loads.at(lightest) += weights.at(page);
+		}
+
+		return shards;
+	}
+
+	/*
+		Manifest of a shard, one record per line:
+		litedocs-shard [shard index] [shard count] [pages in the project]
+		P [page index] [microseconds] [file]	: page, the lines after it belong to it
+		h, f, p [hash]							: hash of the page, its fragment and every part
+		l [link], g [language]					: for the assets and highlighting.css
+	*/
+	const char* shard_manifest_magic = "litedocs-shard";
+
+	void write_shard_manifest(const project_job& job, size_t shard_index, size_t shard_count, size_t project_pages, std::ostream& out)
+	{
+		out << shard_manifest_magic << ' ' << shard_index << ' ' << shard_count << ' ' << project_pages << '\n';
+
+		for (auto& page : job.pages)
+		{
+			out << "P " << page.index << ' ' << page.microseconds << ' ' << page.page->file << '\n';
+
+			if (!page.content_hash.empty()) out << "h " << page.content_hash << '\n';
+			if (!page.fragment_hash.empty()) out << "f " << page.fragment_hash << '\n';
+
+			for (auto& hash : page.part_hashes)
+				out << "p " << hash << '\n';
+
+			for (auto& link : page.links)
+				out << "l " << link << '\n';
+
+			for (auto& language : page.languages)
+				out << "g " << language << '\n';
+		}
+	}
+
+	//Fills the pages of the shard in, covered counts how many shards had every page
+	bool read_shard_manifest(
+		project_job& job,
+		const std::string& manifest,
+		size_t& shard_count,
+		std::vector<size_t>& covered,
+		litedocs::message_callback message
+	)
+	{
+		std::istringstream in(manifest);
+
+		std::string magic;
+		size_t index = 0, count = 0, project_pages = 0;
+
+		if (!(in >> magic >> index >> count >> project_pages) || magic != shard_manifest_magic)
+		{
+			if (message != nullptr) message("[Error] Invalid shard manifest");
+			return false;
+		}
+
+		if (project_pages != job.pages.size() || (shard_count != 0 && count != shard_count))
+		{
+			if (message != nullptr) message("[Error] Shard " + std::to_string(index + 1) + " was built from different sources");
+			return false;
+		}
+
+		shard_count = count;
+		page_job* page = nullptr;
+
+		std::string line;
+		while (std::getline(in, line))
+		{
+			if (line.size() < 2) continue;
+
+			char type = line[0];
+			std::string value = line.substr(2);
+
+			if (type == 'P')
+			{
+				std::istringstream fields(value);
+
+				size_t page_index = 0;
+				long long microseconds = 0;
+				std::string file;
+
+				fields >> page_index >> microseconds;
+				std::getline(fields.ignore(1), file);
+
+				if (page_index >= job.pages.size() || job.pages.at(page_index).page->file != file)
+				{
+					if (message != nullptr) message("[Error] Shard " + std::to_string(index + 1) + " was built from different sources");
+					return false;
+				}
+
+				page = &job.pages.at(page_index);
+				page->microseconds = microseconds;
+				covered.at(page_index)++;
+
+				continue;
+			}
+
+			if (page == nullptr) continue;
+
+			switch (type)
+			{
+			case 'h': page->content_hash = value; break;
+			case 'f': page->fragment_hash = value; break;
+			case 'p': page->part_hashes.push_back(value); break;
+			case 'l': page->links.push_back(value); break;
+			case 'g': page->languages.insert(value); break;
+			}
+		}
+
+		return true;
+	}
+
+	//Name of a page the shard saved, relative to the build folder with / between the sections
+	std::string get_saved_page_name(const project_job& job, const page_job& page, const std::string& extension)
+	{
+		std::string name;
+		for (auto& section : job.project.tree.sections.at(page.index))
+			name += *section + "/";
+
+		return name + page.page->page_name_undescores + extension;
+	}
+
+	//Hashes the merged pages on the worker pool and compares them with the hashes in the manifests,
+	//which go to the precache manifest; pages changed or missing since their shard saved them fail the merge
+	bool verify_shard_pages(
+		generator_state& generator,
+		const project_job& job,
+		litedocs::load_file_callback load_saved_page,
+		litedocs::message_callback message
+	)
+	{
+		struct saved_page
+		{
+			std::string name;
+			const std::string* hash = nullptr;
+			bool matches = false;
+		};
+
+		std::vector<saved_page> saved;
+
+		for (auto& page : job.pages)
+		{
+			if (!page.content_hash.empty()) saved.push_back({ get_saved_page_name(job, page, ".html"), &page.content_hash });
+			if (!page.fragment_hash.empty()) saved.push_back({ get_saved_page_name(job, page, ".fragment.html"), &page.fragment_hash });
+
+			for (size_t i = 0; i < page.part_hashes.size(); i++)
+				saved.push_back({ get_saved_page_name(job, page, ".part" + std::to_string(i + 1) + ".html"), &page.part_hashes.at(i) });
+		}
+
+		worker_pool::task_group verifying;
+
+		for (auto& page : saved)
+		{
+			saved_page* checked = &page;
+
+			generator.pool.submit(verifying, [&job, load_saved_page, checked]()
+			{
+				auto loaded = load_saved_page(checked->name, job.folder);
+				checked->matches = loaded.success && content_hash(loaded.content) == *checked->hash;
+			});
+		}
+
+		generator.pool.wait(verifying);
+
+		bool verified = true;
+
+		for (auto& page : saved)
+		{
+			if (page.matches) continue;
+
+			if (message != nullptr) message("[Error] Merged page differs from its shard's manifest: " + page.name);
+			verified = false;
+		}
+
+		return verified;
+	}
+
+	std::string describe_shard_time(const project_job& job, size_t shard_index, size_t shard_count)
+	{
+		long long microseconds = 0;
+		for (auto& page : job.pages)
+			microseconds += page.microseconds;
+
+		return "[Shard] " + std::to_string(shard_index + 1) + "/" + std::to_string(shard_count) + ": "
+			+ std::to_string(job.pages.size()) + " pages, " + std::to_string(microseconds / 1000) + " ms";
+	}
+}
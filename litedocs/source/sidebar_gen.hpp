@@ -8,52 +8,35 @@ namespace litedocs_internal
 	extern const std::string sidebar_subsection_begin_mark;
 	extern const std::string sidebar_subsection_end_mark;
 
-	void generate_sidebar(std::string& sidebar, const project& project)
+	//Items of the page and its siblings after it, with their subsections
+	void generate_sidebar_items(std::string& items, const project& project, size_t first_page)
 	{
-		std::stringstream sidebar_stream;
-		std::vector<const std::string*> sections;
-
-		for (size_t i = 0; i < project.pages_order.size(); i++)
-		{
-			const auto& page = project.pages_order.at(i);
-
-			if (page.is_go_down)
-			{
-				if (i != 0)
-					sections.push_back(&project.pages_order.at(i - 1).page_name_undescores);
+		const auto& tree = project.tree;
 
-				sidebar_stream << sidebar_subsection_begin_mark;
-			}
-			else if (page.is_go_up)
-			{
-				sidebar_stream << sidebar_subsection_end_mark << sidebar_item_end_mark;
-
-				if (sections.size())
-					sections.pop_back();
-			}
-			else
-			{
-				std::stringstream link_stream;
-				link_stream << "/";
+		items += sidebar_subsection_begin_mark;
 
-				for (auto& upsection : sections)
-					link_stream << *upsection << '/';
-
-				link_stream << page.page_name_undescores << ".html";
-
-				std::string link = link_stream.str();
-
-				sidebar_stream << format_string(
-					sidebar_item_begin_format,
-					{
-						&link,
-						&page.page_name
-					}
-				);
-			}
+		for (size_t page = first_page; page != page_tree::none; page = tree.next_sibling.at(page))
+		{
+			items += format_string(
+				sidebar_item_begin_format,
+				{
+					&tree.link.at(page),
+					&project.pages_order.at(tree.node.at(page)).page_name
+				}
+			);
+
+			if (tree.first_child.at(page) != page_tree::none)
+				generate_sidebar_items(items, project, tree.first_child.at(page));
 		}
 
-		std::string items = sidebar_stream.str();
+		items += sidebar_subsection_end_mark;
+		items += sidebar_item_end_mark;
+	}
+
+	void generate_sidebar(std::string& sidebar, const project& project)
+	{
+		std::string items;
+		generate_sidebar_items(items, project, project.tree.first_root);
 
 		sidebar = format_string(
 			sidebar_format,
@@ -0,0 +1,143 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	/*
+		Markdown shared by many pages, included with a line like <!-- include snippets/install.md -->
+		Every distinct snippet is converted once, the pages get the same html spliced in
+		Links in a snippet are resolved like the including page's own links
+	*/
+
+	//File of an include line, relative to the project folder; empty for other lines
+	std::string get_include_directive(const std::string& content, size_t line_begin, size_t line_end)
+	{
+		static const std::string opening = "<!-- include ";
+		static const std::string closing = "-->";
+
+		while (line_begin < line_end && (content[line_begin] == ' ' || content[line_begin] == '\t')) line_begin++;
+		while (line_end > line_begin && (content[line_end - 1] == ' ' || content[line_end - 1] == '\t' || content[line_end - 1] == '\r')) line_end--;
+
+		if (line_end - line_begin < opening.size() + closing.size()) return "";
+		if (content.compare(line_begin, opening.size(), opening) != 0) return "";
+		if (content.compare(line_end - closing.size(), closing.size(), closing) != 0) return "";
+
+		size_t file_begin = line_begin + opening.size();
+		size_t file_end = line_end - closing.size();
+
+		while (file_end > file_begin && content[file_end - 1] == ' ') file_end--;
+
+		return content.substr(file_begin, file_end - file_begin);
+	}
+
+	//Control characters, which markdown doesn't produce
+	std::string snippet_placeholder(size_t index)
+	{
+		return "\x04" + std::to_string(index) + "\x05";
+	}
+
+	//The converted snippet with given markdown, shared with the other pages and projects including it
+	std::shared_ptr<snippet> get_cached_snippet(generator_state& generator, std::string markdown)
+	{
+		auto& cache = generator.snippets;
+		std::string hash = content_hash(markdown);
+
+		std::lock_guard<std::mutex> lock(cache.mutex);
+
+		auto cached = cache.snippets.find(hash);
+		if (cached != cache.snippets.end())
+			return cached->second;
+
+		//Start over, like the highlighting cache; pages keep the snippets they use alive
+		//The markdown is counted until the snippet is converted, then its html
+		cache.bytes += markdown.size();
+		if (cache.bytes > generator.settings.snippet_cache_bytes)
+		{
+			cache.snippets.clear();
+			cache.bytes = markdown.size();
+		}
+
+		auto created = std::make_shared<snippet>();
+		created->markdown = std::move(markdown);
+		created->hash = hash;
+
+		cache.snippets.insert({ hash, created });
+		return created;
+	}
+
+	//Converts the snippet on the first use, later uses wait for it
+	void convert_snippet(generator_state& generator, snippet& converted)
+	{
+		std::call_once(converted.converted, [&]()
+		{
+			//Code blocks are highlighted right away, the html goes to many pages
+			auto previous_context = current_render_context;
+			current_render_context = { &generator, &converted.languages, nullptr, previous_context.page, previous_context.message };
+
+			converted.html = markdown_parsing::markdown_to_html(converted.markdown, generator.html_tags);
+
+			size_t markdown_size = converted.markdown.size();
+			converted.markdown = {};
+
+			current_render_context = previous_context;
+
+			//Unless the cache started over since
+			auto& cache = generator.snippets;
+			std::lock_guard<std::mutex> lock(cache.mutex);
+
+			auto cached = cache.snippets.find(converted.hash);
+			if (cached != cache.snippets.end() && cached->second.get() == &converted)
+				cache.bytes = cache.bytes - markdown_size + converted.html.size();
+		});
+	}
+
+	//Replaces the placeholders in html with the snippets' html, together with the paragraphs the parser put them in
+	void splice_snippets(std::string& html, const std::vector<std::shared_ptr<snippet>>& snippets)
+	{
+		if (snippets.empty() || html.find('\x04') == std::string::npos) return;
+
+		std::string spliced;
+		spliced.reserve(html.size());
+
+		size_t cursor = 0;
+		size_t found = html.find('\x04');
+
+		while (found != std::string::npos)
+		{
+			size_t end = html.find('\x05', found);
+			if (end == std::string::npos) break;
+
+			size_t index = 0;
+			bool valid = end != found + 1;
+
+			for (size_t i = found + 1; i < end && valid; i++)
+			{
+				valid = std::isdigit(static_cast<unsigned char>(html[i])) != 0;
+				index = index * 10 + (html[i] - '0');
+			}
+
+			if (!valid || index >= snippets.size())
+			{
+				found = html.find('\x04', found + 1);
+				continue;
+			}
+
+			size_t begin = found;
+			size_t after = end + 1;
+
+			if (begin >= 3 && html.compare(begin - 3, 3, "<p>") == 0 && html.compare(after, 4, "</p>") == 0)
+			{
+				begin -= 3;
+				after += 4;
+			}
+
+			spliced.append(html, cursor, begin - cursor);
+			spliced += snippets.at(index)->html;
+
+			cursor = after;
+			found = html.find('\x04', cursor);
+		}
+
+		spliced.append(html, cursor, std::string::npos);
+		html.swap(spliced);
+	}
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	extern const std::string split_script;
+
+	//Where a heading's section begins, before the <a name="..."></a> the parser puts in front of the heading
+	size_t get_section_begin(const std::string& html, size_t heading)
+	{
+		size_t i = heading;
+		while (i > 0 && (html[i - 1] == ' ' || html[i - 1] == '\n')) i--;
+
+		if (i < 4 || html.compare(i - 4, 4, "</a>") != 0) return heading;
+
+		size_t anchor = html.rfind("<a name=\"", i - 4);
+		if (anchor == std::string::npos || html.find('<', anchor + 1) != i - 4) return heading;
+
+		return anchor;
+	}
+
+	//Sections begin at the headings; a part ends before the section which would make it bigger than threshold
+	//A section bigger than threshold on its own becomes a part of its own
+	std::vector<size_t> find_split_points(const std::string& html, size_t begin, size_t end, size_t threshold)
+	{
+		std::vector<size_t> points;
+
+		size_t part_begin = begin;
+		size_t last_section = std::string::npos;
+
+		for (size_t found = html.find("<h", begin); found < end; found = html.find("<h", found + 2))
+		{
+			if (found + 2 >= end || html[found + 2] < '1' || html[found + 2] > '6') continue;
+
+			size_t section = get_section_begin(html, found);
+			if (section <= part_begin) continue;
+
+			if (section - part_begin > threshold && last_section != std::string::npos)
+			{
+				points.push_back(last_section);
+				part_begin = last_section;
+			}
+
+			if (section - part_begin > threshold)
+			{
+				points.push_back(section);
+				part_begin = section;
+				last_section = std::string::npos;
+				continue;
+			}
+
+			last_section = section;
+		}
+
+		if (end - part_begin > threshold && last_section != std::string::npos)
+			points.push_back(last_section);
+
+		return points;
+	}
+
+	//Names of the <a name="..."> anchors and ids in the html, for navigating to them before the part is loaded
+	void collect_anchor_names(const std::string& html, std::string& names)
+	{
+		for (const char* attribute : { "<a name=\"", " id=\"" })
+		{
+			size_t attribute_size = std::strlen(attribute);
+
+			for (size_t found = html.find(attribute); found != std::string::npos; found = html.find(attribute, found + 1))
+			{
+				size_t name_begin = found + attribute_size;
+				size_t name_end = html.find('"', name_begin);
+				if (name_end == std::string::npos) break;
+
+				if (!names.empty()) names += '\n';
+				names.append(html, name_begin, name_end - name_begin);
+			}
+		}
+	}
+
+	//Moves everything after the first part of the content, between begin and end of html, to parts
+	//The first part ends with a placeholder for every other part, which split_script fills in
+	//link_prefix	: link to the parts without their number and extension
+	void split_page_content(
+		std::string& html,
+		size_t begin,
+		size_t end,
+		size_t threshold,
+		const std::string& link_prefix,
+		std::vector<std::string>& parts
+	)
+	{
+		auto points = find_split_points(html, begin, end, threshold);
+		if (points.empty()) return;
+
+		std::string placeholders = "<div class=\"split_parts\">";
+
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			size_t part_end = i + 1 < points.size() ? points.at(i + 1) : end;
+			parts.push_back(html.substr(points.at(i), part_end - points.at(i)));
+
+			std::string anchors;
+			collect_anchor_names(parts.back(), anchors);
+
+			placeholders += "<div class=\"split_part\" data-src=\"" + link_prefix + std::to_string(i + 1) + ".html\" data-anchors=\"" + anchors + "\"></div>";
+		}
+
+		placeholders += "</div>";
+
+		html.replace(points.front(), end - points.front(), placeholders);
+	}
+}
+
+/*
+	Fills in the parts of a split page in order, once the end of what is loaded scrolls near
+	Navigating to an anchor in a part not loaded yet loads the parts up to it first
+*/
+const std::string litedocs_internal::split_script = R"(
+	<!-- Generate Split Pages -->
+	<script>
+	(function () {
+		var observed = null;
+		var observer = null;
+		var loading = null;
+
+		function next_part(container) {
+			return container.querySelector(".split_part");
+		}
+
+		function load_next(container) {
+			if (loading) return loading;
+
+			var part = next_part(container);
+			if (!part) return Promise.resolve();
+
+			loading = fetch(part.getAttribute("data-src")).then(function (response) {
+				if (!response.ok) throw new Error(response.status);
+				return response.text();
+			}).then(function (html) {
+				var holder = document.createElement("template");
+				holder.innerHTML = html;
+
+				container.parentNode.insertBefore(holder.content, container);
+				part.remove();
+			}).finally(function () {
+				loading = null;
+			});
+
+			return loading;
+		}
+
+		function is_near(container) {
+			var content = container.closest(".content");
+			return container.getBoundingClientRect().top < content.getBoundingClientRect().bottom + content.clientHeight;
+		}
+
+		function fill(container) {
+			if (container !== observed || !next_part(container) || !is_near(container)) return;
+			load_next(container).then(function () { fill(container); }).catch(function () {});
+		}
+
+		function find_anchor(name) {
+			return document.getElementById(name) || document.getElementsByName(name)[0];
+		}
+
+		function show_anchor() {
+			var container = observed;
+			var name = decodeURIComponent(location.hash.slice(1));
+			if (!container || !name || find_anchor(name)) return;
+
+			var parts = container.querySelectorAll(".split_part");
+			for (var i = 0; i < parts.length; i++) {
+				if (parts[i].getAttribute("data-anchors").split("\n").indexOf(name) === -1) continue;
+
+				var left = i + 1;
+				var step = function () {
+					if (left-- === 0) {
+						var anchor = find_anchor(name);
+						if (anchor) anchor.scrollIntoView();
+						else show_anchor();
+						return;
+					}
+					load_next(container).then(step).catch(function () {});
+				};
+				step();
+				return;
+			}
+		}
+
+		//Pages swapped in by the navigation script bring their own placeholders
+		function setup() {
+			var container = document.querySelector(".content .split_parts");
+			if (container === observed) return;
+
+			if (observer) observer.disconnect();
+			observed = container;
+			observer = null;
+			if (!container) return;
+
+			if ("IntersectionObserver" in window) {
+				observer = new IntersectionObserver(function (entries) {
+					if (entries[0].isIntersecting) fill(container);
+				}, { root: container.closest(".content"), rootMargin: "100% 0px" });
+				observer.observe(container);
+			}
+
+			fill(container);
+			show_anchor();
+		}
+
+		new MutationObserver(setup).observe(document.querySelector(".main"), { childList: true });
+		window.addEventListener("hashchange", show_anchor);
+
+		setup();
+	})();
+	</script>
+)";
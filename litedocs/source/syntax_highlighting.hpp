@@ -10,6 +10,7 @@ namespace litedocs_internal
 		struct rule 
 		{ 
 			std::string color;
+			std::string css_class;	//short class name, one per distinct color in the language
 			virtual ~rule() {}; 
 		};
 
@@ -32,6 +33,9 @@ namespace litedocs_internal
 		std::vector<rule*> rules;
 		std::vector<std::string> breaks;
 
+		std::string css_class;				//class of the whole highlighted block, derived from language name
+		std::vector<std::string> colors;	//distinct colors, index is the number in rule's css_class
+
 		~highlighting_rules()
 		{
 			for (auto* _rule : rules)
@@ -39,6 +43,43 @@ namespace litedocs_internal
 		}
 	};
 
+#ifdef LITEDOCS_HIGHLIGHTING_PROFILE
+	/*
+		Time spent in each part of apply_rules, for benchmarking the highlighter
+	*/
+	struct highlighting_profile
+	{
+		//Nanoseconds
+		long long tokenizing = 0;
+		long long keywords_rules = 0;
+		long long pairs_rules = 0;
+		long long regex_rules = 0;
+	};
+
+	//Profile to add the timings to, nullptr disables the timers
+	highlighting_profile* active_highlighting_profile = nullptr;
+
+	struct highlighting_profile_timer
+	{
+		long long highlighting_profile::* counter;
+		std::chrono::steady_clock::time_point begin;
+
+		highlighting_profile_timer(long long highlighting_profile::* _counter) 
+			: counter(_counter), begin(std::chrono::steady_clock::now()) {}
+
+		~highlighting_profile_timer()
+		{
+			if (active_highlighting_profile == nullptr) return;
+			auto elapsed = std::chrono::steady_clock::now() - begin;
+			active_highlighting_profile->*counter += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		}
+	};
+
+	#define litedocs_profile_highlighting(counter) highlighting_profile_timer _profile_timer(&highlighting_profile::counter)
+#else
+	#define litedocs_profile_highlighting(counter)
+#endif
+
 	highlighting_rules* load_highlighting_rules_from_json(const nlohmann::json& json)
 	{
 		auto hg = std::make_unique<highlighting_rules>();
@@ -95,6 +136,20 @@ namespace litedocs_internal
 
 			std::sort(hg->breaks.begin(), hg->breaks.end(), 
 				[](const std::string& a, const std::string& b) {return a.size() > b.size();});
+
+			//Give every distinct color a short class, so tokens don't carry inline styles
+			for (auto* _rule : hg->rules)
+			{
+				std::string color = _rule->color;
+				for (auto& c : color)
+					c = std::tolower(static_cast<unsigned char>(c));
+
+				size_t id = std::find(hg->colors.begin(), hg->colors.end(), color) - hg->colors.begin();
+				if (id == hg->colors.size())
+					hg->colors.push_back(color);
+
+				_rule->css_class = "c" + std::to_string(id);
+			}
 		}
 		catch (const std::exception&)
 		{
@@ -104,40 +159,127 @@ namespace litedocs_internal
 		return hg.release();
 	}
 
-	void try_to_load_highlighting_rules(const std::string& language_name)
+	//Returns nullptr if the file is missing or invalid
+	highlighting_rules* load_highlighting_rules_from_file(const std::filesystem::path& path, const std::string& language_name)
 	{
-		std::string dir = get_executable_dir();
-		dir += "/langs/";
+		if (!std::filesystem::exists(path)) return nullptr;
+
+		auto file = std::fstream(path);
+		if (!file.good()) return nullptr;
+
+		highlighting_rules* rules = nullptr;
+
+		try
+		{
+			auto rules_json = nlohmann::json::parse(file);
+			rules = load_highlighting_rules_from_json(rules_json);
+		}
+		catch (const std::exception&)
+		{
+			return nullptr;
+		}
+
+		if (rules == nullptr) return nullptr;
+
+		rules->css_class = "hl_" + language_name;
+		for (auto& c : rules->css_class)
+			if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-')
+				c = '_';
+
+		return rules;
+	}
+
+	//Expects locked highlighted_languages_mutex
+	void try_to_load_highlighting_rules(generator_state& generator, const std::string& language_name)
+	{
+		std::string dir = generator.settings.langs_directory;
+		dir += "/";
 		dir += language_name;
 		dir += ".json";
 
-		std::filesystem::path path(dir);
+		generator.highlighted_languages.insert({ language_name, load_highlighting_rules_from_file(dir, language_name) });
+	}
+
+	/*
+		Limits on highlighting one code block, so a pathological block can't stall the page
+		Work is counted in characters the tokenizer and the rules examine
+	*/
+	struct highlighting_budget
+	{
+		static constexpr size_t clock_check_interval = 4096;
+
+		bool limited_work = false;
+		size_t work_left = 0;
+
+		bool limited_time = false;
+		std::chrono::steady_clock::time_point deadline;
+		size_t until_clock_check = clock_check_interval;
 
-		if (!std::filesystem::exists(path)) goto _try_to_load_highlighting_rules_fail;
+		bool exceeded = false;
 
+		//Tokens longer than this are not matched against regex rules, 0 if any are
+		size_t regex_token_limit = 0;
+
+		//Returns false once either limit runs out
+		bool spend(size_t work)
 		{
-			auto file =  std::fstream(path);
-			if (!file.good()) goto _try_to_load_highlighting_rules_fail;
+			if (exceeded) return false;
 
-			auto rules_json = nlohmann::json::parse(file);
-			auto rules = load_highlighting_rules_from_json(rules_json);
-		
-			if (rules == nullptr) goto _try_to_load_highlighting_rules_fail;
+			if (limited_work)
+			{
+				if (work >= work_left) { exceeded = true; return false; }
+				work_left -= work;
+			}
+
+			if (limited_time)
+			{
+				if (work < until_clock_check)
+				{
+					until_clock_check -= work;
+					return true;
+				}
 
-			highlighted_languages.insert({ language_name, rules });
+				until_clock_check = clock_check_interval;
+				if (std::chrono::steady_clock::now() >= deadline) { exceeded = true; return false; }
+			}
 
-			return;
+			return true;
 		}
+	};
+
+	highlighting_budget make_highlighting_budget(const litedocs::generator_settings& settings, size_t code_size)
+	{
+		highlighting_budget budget;
 
-	_try_to_load_highlighting_rules_fail:
+		//Short blocks get the allowance of a 1 KB one
+		if (settings.highlighting_work_budget != 0)
+		{
+			budget.limited_work = true;
+			budget.work_left = settings.highlighting_work_budget * std::max<size_t>(code_size, 1024);
+		}
 
-		highlighted_languages.insert({ language_name, nullptr });
+		if (settings.highlighting_time_budget_ms != 0)
+		{
+			budget.limited_time = true;
+			budget.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(settings.highlighting_time_budget_ms);
+		}
+
+		budget.regex_token_limit = settings.highlighting_regex_token_limit;
+
+		return budget;
 	}
 
-	std::string apply_rules(highlighting_rules* rules, const std::string& source, size_t code_begin, size_t code_end)
+	//Stops early with budget.exceeded set, the output is incomplete then
+	std::string apply_rules(highlighting_rules* rules, const std::string& source, size_t code_begin, size_t code_end, highlighting_budget& budget)
 	{
+		std::string out;
+		out.reserve(2 * (code_end - code_begin) + 64);
+
 		auto& iterator = code_begin;
-		std::stringstream ss;
+
+		out += "<span class=\"";
+		out += rules->css_class;
+		out += "\">";
 
 		auto dump_whitespaces = [&]()
 		{
@@ -150,7 +292,7 @@ namespace litedocs_internal
 				iterator++;
 			}
 
-			ss << source.substr(begin, iterator - begin);
+			append_html_escaped(out, source.data() + begin, iterator - begin);
 		};
 
 		auto check_should_break = [&](const std::string& _break) -> bool
@@ -172,6 +314,8 @@ namespace litedocs_internal
 
 		auto get_token = [&]()
 		{
+			litedocs_profile_highlighting(tokenizing);
+
 			if (buffor_token != nullptr)
 			{
 				iterator += buffor_token->size();
@@ -185,6 +329,8 @@ namespace litedocs_internal
 
 			while (iterator < code_end)
 			{
+				if (!budget.spend(rules->breaks.size() + 1)) break;
+
 				auto& c = source.at(iterator);
 
 				for (auto& b : rules->breaks)
@@ -216,6 +362,8 @@ namespace litedocs_internal
 			bool previous_was_escape = false;
 			while (iterator < code_end)
 			{
+				if (!budget.spend(1)) break;
+
 				auto& c = source.at(iterator);
 
 				if (check_should_break(_break) && !previous_was_escape)
@@ -233,13 +381,15 @@ namespace litedocs_internal
 
 		auto handle_keyword_rule = [&](highlighting_rules::keywords_rule* r, std::string& token) -> bool
 		{
+			litedocs_profile_highlighting(keywords_rules);
+
 			if (r->keywords.find(token) != r->keywords.end())
 			{
-				ss << "<span style=\"color:";
-				ss << r->color;
-				ss << ";\">";
-				ss << token;
-				ss << "</span>";
+				out += "<span class=\"";
+				out += r->css_class;
+				out += "\">";
+				append_html_escaped(out, token);
+				out += "</span>";
 
 				return true;
 			}
@@ -249,23 +399,25 @@ namespace litedocs_internal
 
 		auto handle_pairs_rule = [&](highlighting_rules::pairs_rule* r, std::string& token) -> bool
 		{
+			litedocs_profile_highlighting(pairs_rules);
+
 			if (r->begin == token)
 			{
-				ss << "<span style=\"color:";
-				ss << r->color;
-				ss << ";\">";
+				out += "<span class=\"";
+				out += r->css_class;
+				out += "\">";
 
-				ss << token;
+				append_html_escaped(out, token);
 
-				while (iterator < code_end)
+				while (iterator < code_end && !budget.exceeded)
 				{
 					auto token2 = get_token_in_pairs(r->end);
-					ss << token2;
+					append_html_escaped(out, token2);
 
 					if (token2 == r->end) break;
 				}
 
-				ss << "</span>";
+				out += "</span>";
 
 				return true;
 			}
@@ -275,18 +427,24 @@ namespace litedocs_internal
 
 		auto handle_regex_rule = [&](highlighting_rules::regex_rule* r, std::string& token) -> bool
 		{
+			litedocs_profile_highlighting(regex_rules);
+
+			//A single match can't be interrupted, a slow one is only noticed after it returns
+			//so long tokens, where backtracking can take forever, are left plain
+			if (budget.regex_token_limit != 0 && token.size() > budget.regex_token_limit) return false;
+			if (!budget.spend(token.size() + 1)) return false;
 			if (!std::regex_match(token, r->regex)) return false;
 
-			ss << "<span style=\"color:";
-			ss << r->color;
-			ss << ";\">";
-			ss << token;
-			ss << "</span>";
+			out += "<span class=\"";
+			out += r->css_class;
+			out += "\">";
+			append_html_escaped(out, token);
+			out += "</span>";
 
 			return true;
 		};
 
-		while (iterator < code_end)
+		while (iterator < code_end && !budget.exceeded)
 		{
 			auto token = get_token();
 
@@ -322,27 +480,240 @@ namespace litedocs_internal
 			}
 
 			if (!rule_found)
-				ss << token;
+				append_html_escaped(out, token);
 		}
 
-		return ss.str();
+		out += "</span>";
+
+		return out;
 	}
 
-	std::string higlight_syntax(const std::string& language_name, const std::string & source, size_t code_begin, size_t code_end)
+	//Code left unhighlighted, when there are no rules or the budget ran out
+	std::string escape_code(const std::string& source, size_t code_begin, size_t code_end)
+	{
+		std::string escaped;
+		escaped.reserve(code_end - code_begin);
+		append_html_escaped(escaped, source.data() + code_begin, code_end - code_begin);
+		return escaped;
+	}
+
+	//Applies the rules within the budget, over_budget is set if it ran out
+	std::string apply_rules_within_budget(
+		generator_state& generator,
+		highlighting_rules* rules,
+		const std::string& source,
+		size_t code_begin,
+		size_t code_end,
+		bool& over_budget
+	)
+	{
+		auto budget = make_highlighting_budget(generator.settings, code_end - code_begin);
+		std::string highlighted = apply_rules(rules, source, code_begin, code_end, budget);
+
+		over_budget = budget.exceeded;
+		if (over_budget) return escape_code(source, code_begin, code_end);
+
+		return highlighted;
+	}
+
+	//over_budget	: optional, set if the block is left unhighlighted because the budget ran out
+	std::string highlight_code(
+		generator_state& generator,
+		const std::string& language_name,
+		const std::string& source,
+		size_t code_begin,
+		size_t code_end,
+		bool* over_budget = nullptr
+	)
 	{
-		auto itr = highlighted_languages.find(language_name);
+		bool exceeded = false;
+		if (over_budget == nullptr) over_budget = &exceeded;
+		*over_budget = false;
+
+		highlighting_rules* rules;
+
+		{
+			std::lock_guard<std::mutex> lock(generator.highlighted_languages_mutex);
+
+			auto itr = generator.highlighted_languages.find(language_name);
+
+			if (itr == generator.highlighted_languages.end())
+			{
+				try_to_load_highlighting_rules(generator, language_name);
+				itr = generator.highlighted_languages.find(language_name);
+			}
+
+			rules = itr->second;
+		}
+
+		if (rules == nullptr)
+			return escape_code(source, code_begin, code_end);
+
+		auto& cache = generator.cache;
+		size_t cache_limit = generator.settings.highlighting_cache_bytes;
+
+		if (cache_limit == 0)
+			return apply_rules_within_budget(generator, rules, source, code_begin, code_end, *over_budget);
+
+		std::string key = language_name;
+		key += '\n';
+		key.append(source, code_begin, code_end - code_begin);
 
-		if (itr == highlighted_languages.end())
 		{
-			try_to_load_highlighting_rules(language_name);
-			itr = highlighted_languages.find(language_name);;
+			std::lock_guard<std::mutex> lock(cache.mutex);
+
+			auto cached = cache.blocks.find(key);
+			if (cached != cache.blocks.end())
+				return cached->second;
 		}
 
-		if (itr->second == nullptr)
+		std::string highlighted = apply_rules_within_budget(generator, rules, source, code_begin, code_end, *over_budget);
+
+		//Not cached, so the next build tries again
+		if (*over_budget) return highlighted;
+
+		std::lock_guard<std::mutex> lock(cache.mutex);
+
+		//Start over instead of tracking which blocks are used the least
+		cache.bytes += key.size() + highlighted.size();
+		if (cache.bytes > cache_limit)
+		{
+			cache.blocks.clear();
+			cache.bytes = key.size() + highlighted.size();
+		}
+
+		cache.blocks.insert({ std::move(key), highlighted });
+
+		return highlighted;
+	}
+
+	void warn_over_budget(litedocs::message_callback message, const std::string& language_name, const std::string* page)
+	{
+		if (message == nullptr) return;
+
+		message("[Warning] Highlighting a " + language_name + " code block" + (page != nullptr ? " in " + *page : std::string()) +
+			" went over the budget, the block is left unhighlighted");
+	}
+
+	//Control characters, which pages rarely contain; pages that do aren't deferred
+	std::string deferred_highlight_placeholder(size_t index)
+	{
+		return "\x02" + std::to_string(index) + "\x03";
+	}
+
+	//Callback for the markdown parser, highlights with the generator rendering on this thread
+	std::string higlight_syntax(const std::string& language_name, const std::string & source, size_t code_begin, size_t code_end)
+	{
+		litedocs_profile_allocations(highlight);
+
+		auto& context = current_render_context;
+
+		if (context.used_languages != nullptr)
+			context.used_languages->insert(language_name);
+
+		if (context.deferred != nullptr)
 		{
-			return source.substr(code_begin, code_end - code_begin);
+			context.deferred->push_back({ language_name, source.substr(code_begin, code_end - code_begin), "", false });
+			return deferred_highlight_placeholder(context.deferred->size() - 1);
 		}
 
-		return apply_rules(itr->second, source, code_begin, code_end);
+		bool over_budget = false;
+		std::string highlighted = highlight_code(*context.generator, language_name, source, code_begin, code_end, &over_budget);
+
+		if (over_budget)
+			warn_over_budget(context.message, language_name, context.page);
+
+		return highlighted;
 	};
+
+	//Highlights the collected code blocks on the worker pool, the calling thread helps
+	void highlight_deferred(
+		generator_state& generator,
+		std::vector<deferred_highlight>& deferred,
+		const std::string& page,
+		litedocs::message_callback message
+	)
+	{
+		worker_pool::task_group blocks_group;
+
+		for (auto& block : deferred)
+			generator.pool.submit(blocks_group, [&]()
+			{
+				litedocs_profile_allocations_page(page);
+				litedocs_profile_allocations(highlight);
+
+				block.html = highlight_code(generator, block.language, block.code, 0, block.code.size(), &block.over_budget);
+				block.code = {};
+			});
+
+		generator.pool.wait(blocks_group);
+
+		//In order, from the calling thread
+		for (auto& block : deferred)
+			if (block.over_budget)
+				warn_over_budget(message, block.language, &page);
+	}
+
+	//Replaces the placeholders in html, from offset on, with the highlighted blocks in order
+	void splice_deferred_highlights(generator_state& generator, std::string& html, size_t offset, const std::vector<deferred_highlight>& deferred)
+	{
+		auto spliced = generator.take_page_buffer();
+		spliced->append(html, 0, offset);
+
+		size_t cursor = offset;
+
+		for (size_t i = 0; i < deferred.size(); i++)
+		{
+			std::string placeholder = deferred_highlight_placeholder(i);
+
+			size_t found = html.find(placeholder, cursor);
+			if (found == std::string::npos) continue;
+
+			spliced->append(html, cursor, found - cursor);
+			spliced->append(deferred.at(i).html);
+			cursor = found + placeholder.size();
+		}
+
+		spliced->append(html, cursor, std::string::npos);
+
+		html.swap(*spliced);
+		generator.return_page_buffer(std::move(spliced));
+	}
+
+#undef litedocs_profile_highlighting
+
+	//Colors of given languages, as css rules for the classes emitted by apply_rules
+	void generate_highlighting_stylesheet(generator_state& generator, std::string& stylesheet, const std::set<std::string>& language_names)
+	{
+		std::vector<const highlighting_rules*> languages;
+
+		{
+			std::lock_guard<std::mutex> lock(generator.highlighted_languages_mutex);
+
+			for (auto& name : language_names)
+			{
+				//Merging shards highlights nothing itself, the rules may not be loaded yet
+				auto itr = generator.highlighted_languages.find(name);
+				if (itr == generator.highlighted_languages.end())
+				{
+					try_to_load_highlighting_rules(generator, name);
+					itr = generator.highlighted_languages.find(name);
+				}
+
+				if (itr != generator.highlighted_languages.end() && itr->second != nullptr)
+					languages.push_back(itr->second);
+			}
+		}
+
+		std::sort(languages.begin(), languages.end(),
+			[](const highlighting_rules* a, const highlighting_rules* b) {return a->css_class < b->css_class;});
+
+		std::stringstream ss;
+
+		for (auto* language : languages)
+			for (size_t i = 0; i < language->colors.size(); i++)
+				ss << "." << language->css_class << " .c" << i << " { color: " << language->colors.at(i) << "; }\n";
+
+		stylesheet = ss.str();
+	}
 }
\ No newline at end of file
@@ -85,6 +85,77 @@ namespace litedocs_internal
 		return result;
 	}
 
+	//64 bit FNV-1a as 16 hex digits, to tell whether two files have the same content
+	struct content_hasher
+	{
+		unsigned long long hash = 14695981039346656037ull;
+
+		void add(const char* data, size_t size)
+		{
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= static_cast<unsigned char>(data[i]);
+				hash *= 1099511628211ull;
+			}
+		}
+
+		std::string digest() const
+		{
+			const char* digits = "0123456789abcdef";
+			std::string result(16, '0');
+			for (size_t i = 0; i < 16; i++)
+				result[15 - i] = digits[(hash >> (i * 4)) & 0xF];
+
+			return result;
+		}
+	};
+
+	std::string content_hash(const std::string& content)
+	{
+		content_hasher hasher;
+		hasher.add(content.data(), content.size());
+		return hasher.digest();
+	}
+
+	//Passes everything written to another stream buffer, hashing it on the way
+	struct hashing_streambuf : std::streambuf
+	{
+		std::streambuf* target;
+		content_hasher hasher;
+
+		hashing_streambuf(std::streambuf* _target) : target(_target) {}
+
+	protected:
+		int_type overflow(int_type c) override
+		{
+			if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+
+			char as_char = traits_type::to_char_type(c);
+			hasher.add(&as_char, 1);
+			return target->sputc(as_char);
+		}
+
+		std::streamsize xsputn(const char* data, std::streamsize size) override
+		{
+			hasher.add(data, static_cast<size_t>(size));
+			return target->sputn(data, size);
+		}
+
+		int sync() override
+		{
+			return target->pubsync();
+		}
+	};
+
+	//Appends to a string with the stream syntax, without the copy std::stringstream::str makes
+	struct string_output
+	{
+		std::string& target;
+
+		string_output& operator<<(const std::string& text) { target += text; return *this; }
+		string_output& operator<<(const char* text) { target += text; return *this; }
+	};
+
 	std::string get_executable_dir();
 }
 
@@ -0,0 +1,156 @@
+#pragma once
+
+namespace litedocs_internal
+{
+	/*
+		Threads running tasks from one shared queue
+		The thread waiting for a group runs queued tasks too, so groups can be nested
+		An exception thrown by a task is kept in its group and thrown again from wait, never on the pool's threads
+	*/
+	struct worker_pool
+	{
+		struct task_group
+		{
+			std::atomic<size_t> pending{ 0 };
+
+			//First exception thrown by the group's tasks, guarded by the pool's mutex
+			std::exception_ptr error;
+		};
+
+		struct task
+		{
+			task_group* group;
+			std::function<void()> function;
+		};
+
+		std::vector<std::thread> threads;
+		std::deque<task> queue;
+
+		std::mutex mutex;
+		std::condition_variable queue_changed;
+		std::condition_variable task_done;
+		bool stopping = false;
+
+		//threads counts the thread calling wait, so 1 runs everything in wait
+		worker_pool(size_t threads_count)
+		{
+			if (threads_count == 0)
+				threads_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+			for (size_t i = 1; i < threads_count; i++)
+				threads.emplace_back([this]() { work(); });
+		}
+
+		~worker_pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			queue_changed.notify_all();
+
+			for (auto& thread : threads)
+				thread.join();
+		}
+
+		size_t size() const
+		{
+			return threads.size() + 1;
+		}
+
+		void submit(task_group& group, std::function<void()> function)
+		{
+			group.pending++;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.push_back({ &group, std::move(function) });
+			}
+			queue_changed.notify_one();
+
+			//Threads in wait run queued tasks as well
+			task_done.notify_all();
+		}
+
+		//Keeps the group pending for work submitted from outside of the pool, until release
+		void hold(task_group& group)
+		{
+			group.pending++;
+		}
+
+		void release(task_group& group)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				group.pending--;
+			}
+			task_done.notify_all();
+		}
+
+		//Rethrows the first exception of the group's tasks, once all of them are done
+		void wait(task_group& group)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			while (group.pending != 0)
+			{
+				if (!queue.empty())
+				{
+					run_front(lock);
+					continue;
+				}
+
+				task_done.wait(lock);
+			}
+
+			if (group.error != nullptr)
+			{
+				auto error = group.error;
+				group.error = nullptr;
+
+				lock.unlock();
+				std::rethrow_exception(error);
+			}
+		}
+
+	private:
+		//Expects locked mutex, returns with it locked again
+		void run_front(std::unique_lock<std::mutex>& lock)
+		{
+			task t = std::move(queue.front());
+			queue.pop_front();
+
+			lock.unlock();
+
+			std::exception_ptr error;
+			try
+			{
+				t.function();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			lock.lock();
+
+			if (error != nullptr && t.group->error == nullptr)
+				t.group->error = error;
+
+			t.group->pending--;
+			task_done.notify_all();
+		}
+
+		void work()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			while (true)
+			{
+				queue_changed.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty()) return;
+
+				run_front(lock);
+			}
+		}
+	};
+}
@@ -12,25 +12,154 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <filesystem>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <algorithm>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#endif
+
+//Callbacks are called from many threads
+std::mutex output_mutex;
+
+/*
+	Sharded builds
+*/
+
+//With --shard i/N the pages of shard i go to [project folder]/build.shard[i], with a manifest for --merge
+//--merge puts build.shard1 to build.shardN together into the build folder and saves the rest
+size_t shard_index = 0;
+size_t shard_count = 0;
+bool merge_output = false;
+
+const char* shard_manifest_name = ".litedocs_shard";
+
+std::string get_shard_directory(const std::string& project_path, size_t index)
+{
+	return project_path + "/build.shard" + std::to_string(index);
+}
+
+std::string get_build_directory(const std::string& project_path)
+{
+	if (shard_count != 0)
+		return get_shard_directory(project_path, shard_index);
+
+	return project_path + "/build";
+}
+
+/*
+	Archive output
+*/
+
+//With --archive every project's build goes into [project folder]/build.tar instead of the build folder
+bool archive_output = false;
+bool archive_index = false;
+
+//key	: build folder
+std::map<std::string, std::unique_ptr<litedocs::archive_writer>> archives;
+
+std::string get_archive_path(const std::string& build_directory)
+{
+	return build_directory + ".tar";
+}
+
+//Pages have the same names as in the build folder, with / between the sections
+void save_page_to_archive(litedocs::archive_writer& archive, litedocs::generated_page* page)
+{
+	std::string name;
+
+	for (auto& s : *page->sections)
+		name += *s + "/";
+	name += page->page_name + page->extension;
+
+	bool saved = page->content != nullptr ? archive.add_file(name, *page->content) : archive.add_file(name, page->write_content);
+
+	std::lock_guard<std::mutex> lock(output_mutex);
+	std::cout << (saved ? "\n[Archived] " : "\n[Error] Failed to archive: ") << name;
+}
+
+//Pages including every snippet, so a changed snippet tells which pages have to be generated again
+//One line per page including a snippet: snippet file, tab, saved page
+const char* includes_manifest_name = ".litedocs_includes";
+
+//key	: build folder
+//value : map of snippet files and pages including them
+std::map<std::string, std::map<std::string, std::set<std::string>>> included_snippets;
+
+//With the build in an archive, these files are kept next to it
+std::filesystem::path get_build_file_path(const std::string& build_directory, const char* name)
+{
+	if (archive_output)
+		return std::filesystem::path(build_directory).parent_path() / name;
+
+	return std::filesystem::path(build_directory) / name;
+}
+
+void save_includes_manifest(const std::string& build_directory)
+{
+	auto& snippets = included_snippets[build_directory];
+	if (snippets.empty()) return;
+
+	std::ofstream manifest(get_build_file_path(build_directory, includes_manifest_name));
+
+	for (auto& snippet : snippets)
+		for (auto& page : snippet.second)
+			manifest << snippet.first << '\t' << page << '\n';
+}
 
 void save_page(litedocs::generated_page* page, const std::string& project_path)
 {
-	std::string build_dir = project_path + "/build/";
+	if (page->includes != nullptr && !page->includes->empty())
+	{
+		std::string name;
+
+		for (auto& s : *page->sections)
+			name += *s + "/";
+		name += page->page_name + page->extension;
+
+		std::lock_guard<std::mutex> lock(output_mutex);
+		for (auto& snippet : *page->includes)
+			included_snippets[get_build_directory(project_path)][snippet].insert(name);
+	}
+
+	if (archive_output)
+	{
+		save_page_to_archive(*archives.at(get_build_directory(project_path)), page);
+		return;
+	}
+
+	std::string build_dir = get_build_directory(project_path) + "/";
 	std::string name;
 
 	for (auto& s : *page->sections)
-		name += *s + "\\";
-	name += page->page_name + ".html";
+		name += *s + "/";
+	name += page->page_name + page->extension;
 
 	auto path = std::filesystem::path(build_dir + name);
 
-	std::filesystem::create_directories(path.parent_path());
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
 
 	auto f = std::ofstream(path);
-	f << *page->content;
+
+	if (page->content != nullptr)
+		f << *page->content;
+	else
+		page->write_content(f);
+
 	f.close();
 
+	std::lock_guard<std::mutex> lock(output_mutex);
 	std::cout << "\n[Saved] " << name;
 }
 
@@ -57,8 +186,275 @@ litedocs::loaded_file load_file(std::string filename, const std::string& project
 	return result;
 }
 
+//Pages merged from the shards, read back as save_page wrote them to check them against the shard manifests
+litedocs::loaded_file load_merged_page(std::string filename, const std::string& project_path)
+{
+	litedocs::loaded_file result;
+
+	std::ifstream file(std::filesystem::path(get_build_directory(project_path)) / filename);
+	if (!file.good()) return result;
+
+	result.content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	result.success = true;
+
+	return result;
+}
+
+/*
+	Assets
+*/
+
+//Assets saved by the previous run, so unchanged ones are not copied again
+//key	: build folder
+//value : map of paths relative to the build folder and content hashes
+std::map<std::string, std::map<std::string, std::string>> previous_assets;
+std::map<std::string, std::map<std::string, std::string>> current_assets;
+
+const char* assets_manifest_name = ".litedocs_assets";
+
+//Directory listings for "dir" entries of pages order, so unchanged directories are not read again
+const char* directory_cache_name = ".litedocs_directories";
+
+//Hashes of the asset files, so unchanged assets are not read again
+const char* asset_cache_name = ".litedocs_asset_hashes";
+
+void load_assets_manifest(const std::string& build_directory)
+{
+	std::ifstream manifest(std::filesystem::path(build_directory) / assets_manifest_name);
+
+	std::string hash, path;
+	while (manifest >> hash && std::getline(manifest >> std::ws, path))
+		previous_assets[build_directory][path] = hash;
+}
+
+void save_assets_manifest(const std::string& build_directory, bool build_succeeded)
+{
+	std::ofstream manifest(std::filesystem::path(build_directory) / assets_manifest_name);
+
+	auto& current = current_assets[build_directory];
+
+	//A failed build may not have staged its assets, the previous ones are kept until a build succeeds
+	if (!build_succeeded)
+		current.insert(previous_assets[build_directory].begin(), previous_assets[build_directory].end());
+	for (auto& asset : current)
+		manifest << asset.second << ' ' << asset.first << '\n';
+
+	//Assets no page references anymore
+	for (auto& asset : previous_assets[build_directory])
+		if (current.find(asset.first) == current.end())
+		{
+			std::error_code error;
+			std::filesystem::remove(std::filesystem::path(build_directory) / asset.first, error);
+		}
+}
+
+//Removes everything from the build folder, except assets saved by the previous run
+void clean_build_directory(const std::string& build_directory)
+{
+	std::error_code error;
+	auto& previous = previous_assets[build_directory];
+
+	std::vector<std::filesystem::path> to_remove;
+	for (auto itr = std::filesystem::recursive_directory_iterator(build_directory, error); itr != std::filesystem::recursive_directory_iterator(); itr.increment(error))
+	{
+		if (itr->is_directory()) continue;
+
+		auto relative = std::filesystem::relative(itr->path(), build_directory).generic_string();
+		if (previous.find(relative) == previous.end())
+			to_remove.push_back(itr->path());
+	}
+
+	for (auto& path : to_remove)
+		std::filesystem::remove(path, error);
+}
+
+//Uses reflinks or in-kernel copying when the filesystem supports them
+bool copy_file_fast(const std::filesystem::path& from, const std::filesystem::path& to)
+{
+	std::error_code error;
+
+#ifdef __linux__
+	int in = open(from.c_str(), O_RDONLY);
+	if (in < 0) return false;
+
+	int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (out < 0) { close(in); return false; }
+
+	bool copied = ioctl(out, FICLONE, in) == 0;
+
+	if (!copied)
+	{
+		struct stat info;
+		copied = fstat(in, &info) == 0;
+
+		off_t left = copied ? info.st_size : 0;
+		while (copied && left > 0)
+		{
+			ssize_t done = copy_file_range(in, nullptr, out, nullptr, left, 0);
+			if (done <= 0) copied = false;
+			else left -= done;
+		}
+	}
+
+	close(in);
+	close(out);
+
+	if (copied) return true;
+#endif
+
+	std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing, error);
+	return !error;
+}
+
+//Copies the pages of a shard into the build folder, the shard's own files start with a dot and are left out
+void copy_shard_pages(const std::filesystem::path& shard_directory, const std::filesystem::path& build_directory)
+{
+	std::error_code error;
+
+	for (auto itr = std::filesystem::recursive_directory_iterator(shard_directory, error); itr != std::filesystem::recursive_directory_iterator(); itr.increment(error))
+	{
+		if (itr->is_directory()) continue;
+
+		auto relative = std::filesystem::relative(itr->path(), shard_directory);
+		if (relative.generic_string()[0] == '.') continue;
+
+		auto path = build_directory / relative;
+		std::filesystem::create_directories(path.parent_path(), error);
+		std::filesystem::remove(path, error);
+
+		std::lock_guard<std::mutex> lock(output_mutex);
+		std::cout << (copy_file_fast(itr->path(), path) ? "\n[Merged] " : "\n[Error] Failed to merge: ") << relative.generic_string();
+	}
+}
+
+//Reads the shards of the project and copies their pages, manifests is empty if there is no first shard
+void merge_shard_directories(const std::string& project_path, std::vector<std::string>& manifests)
+{
+	auto build_directory = get_build_directory(project_path);
+
+	for (size_t i = 1; ; i++)
+	{
+		auto shard_directory = get_shard_directory(project_path, i);
+
+		std::ifstream manifest(std::filesystem::path(shard_directory) / shard_manifest_name);
+		if (!manifest.good()) break;
+
+		std::stringstream content;
+		content << manifest.rdbuf();
+		manifests.push_back(content.str());
+
+		copy_shard_pages(shard_directory, build_directory);
+
+		std::ifstream includes(std::filesystem::path(shard_directory) / includes_manifest_name);
+
+		std::string snippet, page;
+		while (std::getline(includes, snippet, '\t') && std::getline(includes, page))
+			included_snippets[build_directory][snippet].insert(page);
+	}
+}
+
+//The first destination gets the content, the others link to it
+void save_asset_to_archive(litedocs::archive_writer& archive, const litedocs::staged_asset* asset, const std::string& project_path)
+{
+	std::ifstream source(std::filesystem::path(project_path) / asset->source, std::ios::binary);
+
+	if (!source.good())
+	{
+		std::lock_guard<std::mutex> lock(output_mutex);
+		std::cout << "\n[Error] Failed to copy asset: " << asset->source;
+		return;
+	}
+
+	for (size_t i = 0; i < asset->destinations.size(); i++)
+	{
+		auto& destination = asset->destinations.at(i);
+
+		bool saved = i == 0
+			? archive.add_file(destination, [&](std::ostream& out) { if (asset->size != 0) out << source.rdbuf(); })
+			: archive.add_link(destination, asset->destinations.front());
+
+		std::lock_guard<std::mutex> lock(output_mutex);
+		std::cout << (!saved ? "\n[Error] Failed to archive: " : i == 0 ? "\n[Archived] " : "\n[Linked] ") << destination;
+	}
+}
+
+void save_asset(const litedocs::staged_asset* asset, const std::string& project_path)
+{
+	if (archive_output)
+	{
+		save_asset_to_archive(*archives.at(get_build_directory(project_path)), asset, project_path);
+		return;
+	}
+
+	auto build_dir = std::filesystem::path(get_build_directory(project_path));
+	auto source = std::filesystem::path(project_path) / asset->source;
+
+	std::lock_guard<std::mutex> lock(output_mutex);
+	auto& previous = previous_assets[build_dir.string()];
+	auto& current = current_assets[build_dir.string()];
+
+	const std::filesystem::path* first_copy = nullptr;
+	std::vector<std::filesystem::path> paths;
+	for (auto& destination : asset->destinations)
+		paths.push_back(build_dir / destination);
+
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		auto& path = paths.at(i);
+		auto& destination = asset->destinations.at(i);
+
+		current[destination] = asset->content_hash;
+
+		std::error_code error;
+
+		auto previous_hash = previous.find(destination);
+		bool unchanged = previous_hash != previous.end() && previous_hash->second == asset->content_hash
+			&& std::filesystem::file_size(path, error) == asset->size && !error;
+
+		if (unchanged)
+		{
+			if (first_copy == nullptr) first_copy = &path;
+			continue;
+		}
+
+		std::filesystem::create_directories(path.parent_path(), error);
+		std::filesystem::remove(path, error);
+
+		//Same content, share the file
+		if (first_copy != nullptr)
+		{
+			std::filesystem::create_hard_link(*first_copy, path, error);
+			if (!error)
+			{
+				std::cout << "\n[Linked] " << destination;
+				continue;
+			}
+		}
+
+		if (!copy_file_fast(source, path))
+		{
+			std::cout << "\n[Error] Failed to copy asset: " << asset->source;
+			current.erase(destination);
+			continue;
+		}
+
+		if (first_copy == nullptr) first_copy = &path;
+		std::cout << "\n[Copied] " << destination;
+	}
+}
+
+//Digits only, false for anything else or numbers too big for value
+bool parse_number(const std::string& text, size_t& value)
+{
+	if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos) return false;
+
+	value = std::stoul(text);
+	return true;
+}
+
 void message_callback(const std::string& message)
 {
+	std::lock_guard<std::mutex> lock(output_mutex);
 	std::cout << message << '\n';
 }
 
@@ -69,25 +465,114 @@ int main(int argc, char* argv[])
 	for (int i = 1; i < argc; i++)
 		arguments.push_back(argv[i]);
 
-	std::filesystem::path project_filepath;
+	std::vector<std::filesystem::path> project_filepaths;
+	litedocs::generator_settings settings;
 
-	if (arguments.size() > 1)
-	{
-		std::cout << "\n[Error] Expected one argument, the litedocs project filepath";
-		return 0;
-	}
+#ifdef LITEDOCS_ALLOCATION_PROFILE
+	std::string allocations_sort = "bytes";
+	std::string allocations_json = "litedocs_allocations.json";
+#endif
 
-	if (arguments.size() == 1)
+	for (size_t i = 0; i < arguments.size(); i++)
 	{
-		project_filepath = arguments.back();
+		if (arguments.at(i) == "--threads" || arguments.at(i) == "-j")
+		{
+			if (i + 1 == arguments.size() || !parse_number(arguments.at(i + 1), settings.threads))
+			{
+				std::cout << "\n[Error] Expected number of threads after " << arguments.at(i);
+				return 0;
+			}
+
+			i++;
+			continue;
+		}
+
+		if (arguments.at(i) == "--highlighting-budget")
+		{
+			if (i + 1 == arguments.size() || !parse_number(arguments.at(i + 1), settings.highlighting_time_budget_ms))
+			{
+				std::cout << "\n[Error] Expected milliseconds after " << arguments.at(i);
+				return 0;
+			}
+
+			i++;
+			continue;
+		}
+
+		if (arguments.at(i) == "--ordered")
+		{
+			settings.ordered_output = true;
+			continue;
+		}
+
+		if (arguments.at(i) == "--shard")
+		{
+			size_t separator = i + 1 < arguments.size() ? arguments.at(i + 1).find('/') : std::string::npos;
+
+			bool valid = separator != std::string::npos
+				&& parse_number(arguments.at(i + 1).substr(0, separator), shard_index)
+				&& parse_number(arguments.at(i + 1).substr(separator + 1), shard_count);
+
+			if (!valid || shard_index == 0 || shard_index > shard_count)
+			{
+				std::cout << "\n[Error] Expected shard like 1/4 after " << arguments.at(i);
+				return 0;
+			}
+
+			i++;
+			continue;
+		}
+
+		if (arguments.at(i) == "--merge")
+		{
+			merge_output = true;
+			continue;
+		}
+
+		//Saved in order, so the same sources give the same archive
+		if (arguments.at(i) == "--archive" || arguments.at(i) == "--archive-index")
+		{
+			archive_output = true;
+			archive_index = archive_index || arguments.at(i) == "--archive-index";
+			settings.ordered_output = true;
+			continue;
+		}
+
+#ifdef LITEDOCS_ALLOCATION_PROFILE
+		if ((arguments.at(i) == "--allocations-sort" || arguments.at(i) == "--allocations-json") && i + 1 < arguments.size())
+		{
+			(arguments.at(i) == "--allocations-sort" ? allocations_sort : allocations_json) = arguments.at(i + 1);
+			i++;
+			continue;
+		}
+#endif
+
+		std::filesystem::path project_filepath = arguments.at(i);
 		if (!std::filesystem::exists(project_filepath) || std::filesystem::is_directory(project_filepath))
 		{
-			std::cout << "\n[Error] Invalid path";
+			std::cout << "\n[Error] Invalid path: " << arguments.at(i);
 			return 0;
 		}
+
+		project_filepaths.push_back(project_filepath);
 	}
-	else
+
+	if (archive_output && (shard_count != 0 || merge_output))
+	{
+		std::cout << "\n[Error] Sharded builds can't be archived";
+		return 0;
+	}
+
+	if (shard_count != 0 && merge_output)
+	{
+		std::cout << "\n[Error] Expected either --shard or --merge";
+		return 0;
+	}
+
+	if (project_filepaths.empty())
 	{
+		std::filesystem::path project_filepath;
+
 		while (true)
 		{
 			std::cout << "Litedocs project filepath (.json file): ";
@@ -96,15 +581,134 @@ int main(int argc, char* argv[])
 			if (std::filesystem::exists(project_filepath) && !std::filesystem::is_directory(project_filepath)) break;
 			std::cout << "\n[Error] Invalid project filepath\n";
 		}
+
+		project_filepaths.push_back(project_filepath);
+	}
+
+	litedocs::generator generator(settings);
+
+	//Generate build folders
+	std::vector<std::string> project_files;
+	std::vector<std::string> build_directories;
+
+	for (auto& project_filepath : project_filepaths)
+	{
+		project_files.push_back(project_filepath.string());
+		build_directories.push_back(get_build_directory(project_filepath.parent_path().string()));
+
+		std::ifstream directory_cache(get_build_file_path(build_directories.back(), directory_cache_name));
+		generator.load_directory_cache(directory_cache);
+
+		std::ifstream asset_cache(get_build_file_path(build_directories.back(), asset_cache_name));
+		generator.load_asset_cache(asset_cache);
+
+		if (archive_output)
+		{
+			auto& archive = archives[build_directories.back()];
+			if (archive != nullptr) continue;
+
+			archive = std::make_unique<litedocs::archive_writer>();
+			if (!archive->open(get_archive_path(build_directories.back())))
+			{
+				std::cout << "\n[Error] Failed to create archive: " << get_archive_path(build_directories.back());
+				return 0;
+			}
+
+			continue;
+		}
+
+		//Shards save no assets, their folders start empty
+		if (shard_count == 0)
+			load_assets_manifest(build_directories.back());
+
+		clean_build_directory(build_directories.back());
+		std::filesystem::create_directories(build_directories.back());
+	}
+
+	//Of every project, so one failing project doesn't change how the others are cleaned up
+	std::vector<bool> succeeded(project_files.size(), true);
+
+	if (shard_count != 0)
+	{
+		for (size_t i = 0; i < project_files.size(); i++)
+		{
+			std::string manifest;
+			succeeded.at(i) = generator.generate_shard(project_files.at(i), shard_index - 1, shard_count, load_file, save_page, message_callback, manifest);
+
+			if (succeeded.at(i))
+				std::ofstream(get_build_file_path(build_directories.at(i), shard_manifest_name)) << manifest;
+		}
+	}
+	else if (merge_output)
+	{
+		for (size_t i = 0; i < project_files.size(); i++)
+		{
+			std::vector<std::string> manifests;
+			merge_shard_directories(project_filepaths.at(i).parent_path().string(), manifests);
+
+			if (manifests.empty())
+			{
+				std::cout << "\n[Error] No shards to merge: " << get_shard_directory(project_filepaths.at(i).parent_path().string(), 1);
+				succeeded.at(i) = false;
+				continue;
+			}
+
+			succeeded.at(i) = generator.merge_shards(project_files.at(i), manifests, load_file, save_page, message_callback, save_asset, load_merged_page);
+
+			//The pages copied from the shards would look like a whole build
+			if (!succeeded.at(i))
+			{
+				clean_build_directory(build_directories.at(i));
+				included_snippets.erase(build_directories.at(i));
+			}
+		}
 	}
+	else generator.generate_batch(project_files, load_file, save_page, message_callback, save_asset, &succeeded);
+
+	for (size_t i = 0; i < build_directories.size(); i++)
+	{
+		auto& build_directory = build_directories.at(i);
+
+		if (archive_output)
+		{
+			auto& archive = archives.at(build_directory);
+
+			if (archive != nullptr)
+			{
+				bool saved = archive->close(archive_index);
+				succeeded.at(i) = saved && succeeded.at(i);
+
+				std::cout << (saved ? "\n[Saved] " : "\n[Error] Failed to save archive: ") << get_archive_path(build_directory);
+			}
 
-	//Generate build folder
-	std::filesystem::path build_directory = project_filepath.parent_path().string() + "/build";
+			archive = nullptr;
+		}
+		else if (shard_count == 0) save_assets_manifest(build_directory, succeeded.at(i));
+
+		save_includes_manifest(build_directory);
+
+		std::stringstream directory_cache;
+		generator.save_directory_cache(directory_cache);
+
+		if (!directory_cache.str().empty())
+			std::ofstream(get_build_file_path(build_directory, directory_cache_name)) << directory_cache.str();
+
+		std::stringstream asset_cache;
+		generator.save_asset_cache(asset_cache);
+
+		if (!asset_cache.str().empty())
+			std::ofstream(get_build_file_path(build_directory, asset_cache_name)) << asset_cache.str();
+	}
 
-	std::filesystem::remove_all(build_directory);
-	std::filesystem::create_directories(build_directory);
+#ifdef LITEDOCS_ALLOCATION_PROFILE
+	std::cout << "\n\n";
+	litedocs::write_allocation_report(std::cout, allocations_sort);
 
-	litedocs::generate_docs(project_filepath.string(), load_file, save_page, message_callback);
+	std::ofstream json(allocations_json);
+	litedocs::write_allocation_report_json(json);
+	std::cout << "\n[Saved] " << allocations_json << '\n';
+#endif
 
-	return 0;
+	//Build scripts, like the ones running shards on many machines, tell failed builds by the exit code
+	return std::find(succeeded.begin(), succeeded.end(), false) == succeeded.end() ? 0 : 1;
 }
\ No newline at end of file
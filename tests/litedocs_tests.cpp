@@ -0,0 +1,843 @@
+/*
+	Checks of the generation steps whose mistakes are easy to miss in a generated site
+	Usage: litedocs_tests [litedocs repository dir]
+	Prints the failed checks, returns 1 if there are any
+*/
+
+#define LITEDOCS_IMPLEMENTATION
+#define MARKDOWN_PARSER_IMPLEMENTATION
+
+//https://github.com/nlohmann/json
+#include "../include/nlohmann/json.hpp"
+
+//https://github.com/TakiKacper/MarkdownParser
+#include "../include/markdown_parser.hpp"
+
+#include "../litedocs/litedocs.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <mutex>
+
+size_t checks_count = 0;
+size_t failures_count = 0;
+
+void check(bool condition, const std::string& name)
+{
+	checks_count++;
+	if (condition) return;
+
+	failures_count++;
+	std::cout << "[Failed] " << name << '\n';
+}
+
+/*
+	Projects written to the temporary directory, generated with the callbacks below
+*/
+
+std::string langs_directory;
+
+//Of the last generation
+//key	: path in the build folder
+//value : content
+std::map<std::string, std::string> saved_pages;
+std::vector<std::string> messages;
+std::mutex callbacks_mutex;
+
+void save_test_page(litedocs::generated_page* page, const std::string& project_path)
+{
+	std::string name;
+	for (auto& section : *page->sections)
+		name += *section + "/";
+	name += page->page_name + page->extension;
+
+	std::ostringstream content;
+	if (page->content != nullptr)
+		content << *page->content;
+	else
+		page->write_content(content);
+
+	std::lock_guard<std::mutex> lock(callbacks_mutex);
+	saved_pages[name] = content.str();
+}
+
+//Throws for throws.md, like a callback failing in the middle of a build
+litedocs::loaded_file load_test_file(std::string filename, const std::string& project_path)
+{
+	if (filename == "throws.md")
+		throw std::runtime_error("Failed on purpose");
+
+	litedocs::loaded_file result;
+
+	std::ifstream file(std::filesystem::path(project_path) / filename, std::ios::binary);
+	if (!file.good()) return result;
+
+	result.content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	result.success = true;
+
+	return result;
+}
+
+void collect_message(const std::string& message)
+{
+	std::lock_guard<std::mutex> lock(callbacks_mutex);
+	messages.push_back(message);
+}
+
+bool has_message(const std::string& part)
+{
+	for (auto& message : messages)
+		if (message.find(part) != std::string::npos)
+			return true;
+
+	return false;
+}
+
+//settings	: json members of the project besides name and style, like pages_order
+//Returns the project file
+std::string write_test_project(const std::string& name, const std::string& settings, const std::map<std::string, std::string>& files)
+{
+	auto folder = std::filesystem::temp_directory_path() / ("litedocs_tests_" + name);
+
+	std::filesystem::remove_all(folder);
+	std::filesystem::create_directories(folder);
+
+	for (auto& file : files)
+	{
+		auto path = folder / file.first;
+		std::filesystem::create_directories(path.parent_path());
+		std::ofstream(path, std::ios::binary) << file.second;
+	}
+
+	std::ofstream(folder / "docs.json") << R"({
+		"name" : "Test",
+		"site_language_tag" : "en",
+		"style" : {
+			"navbar_color" : "#026562",
+			"sidebar_text_color" : "#FFFFFF",
+			"sidebar_hover_color" : "#026562",
+			"sidebar_background" : "#1E1E1E",
+			"content_text_color" : "#FFFFFF",
+			"content_background" : "#121212",
+			"code_block_frame_color" : "#026562",
+			"code_block_background" : "#1E1E1E"
+		},
+		)" << settings << "\n}";
+
+	return (folder / "docs.json").string();
+}
+
+bool generate_test_project(const std::string& project_file, size_t threads)
+{
+	saved_pages.clear();
+	messages.clear();
+
+	litedocs::generator_settings settings;
+	settings.threads = threads;
+	settings.langs_directory = langs_directory;
+
+	litedocs::generator generator(settings);
+	return generator.generate(project_file, load_test_file, save_test_page, collect_message);
+}
+
+/*
+	Html escaping
+*/
+
+std::string escape_html_scalar(const std::string& text)
+{
+	std::string escaped;
+
+	for (char c : text)
+	{
+		if (c == '<') escaped += "&lt;";
+		else if (c == '>') escaped += "&gt;";
+		else if (c == '&') escaped += "&amp;";
+		else escaped += c;
+	}
+
+	return escaped;
+}
+
+bool escapes_like_scalar(const std::string& text)
+{
+	std::string escaped = "prefix";
+	litedocs_internal::append_html_escaped(escaped, text);
+
+	return escaped == "prefix" + escape_html_scalar(text);
+}
+
+void test_html_escaping()
+{
+	bool every_offset = true;
+
+	//Entities at every offset of two 32 byte lanes and of the scalar tail after them, alone and next to each other
+	for (size_t size = 1; size <= 80 && every_offset; size++)
+		for (size_t offset = 0; offset < size; offset++)
+			for (char special : { '<', '>', '&' })
+			{
+				std::string text(size, 'a');
+				text[offset] = special;
+				every_offset = every_offset && escapes_like_scalar(text);
+
+				if (offset + 1 < size) text[offset + 1] = '&';
+				every_offset = every_offset && escapes_like_scalar(text);
+			}
+
+	check(every_offset, "escaping matches the scalar escaper at every offset in a lane");
+
+	std::string long_text;
+	for (size_t i = 0; i < 3 * litedocs_internal::html_escape_block + 7; i++)
+		long_text += i % 97 == 0 ? '&' : i % 13 == 0 ? '<' : 'a' + i % 26;
+
+	std::string clean_text(2 * litedocs_internal::html_escape_block + 3, 'a');
+	std::string special_text(litedocs_internal::html_escape_block + 1, '&');
+
+	check(escapes_like_scalar(long_text) && escapes_like_scalar(clean_text) && escapes_like_scalar(special_text) && escapes_like_scalar(""), "escaping matches the scalar escaper across blocks");
+}
+
+/*
+	Generator instances
+*/
+
+void test_generator_instances()
+{
+	auto project = write_test_project("instances", R"("pages_order" : [ "a.md", { "dir" : "guide/" } ])", {
+		{ "a.md", "# A\n\n<!-- include snippets/note.md -->\n\n```json\n{ \"a\" : 1 }\n```\n" },
+		{ "guide/b.md", "# B" },
+		{ "snippets/note.md", "Shared note" }
+	});
+
+	litedocs::generator_settings settings;
+	settings.threads = 2;
+	settings.langs_directory = langs_directory;
+
+	litedocs::generator first(settings);
+	litedocs::generator second(settings);
+
+	saved_pages.clear();
+	messages.clear();
+
+	check(first.generate(project, load_test_file, save_test_page, collect_message), "first generator builds");
+	auto generated = saved_pages;
+
+	litedocs::loaded_project loaded;
+	std::string html;
+
+	bool rendered = first.load_project(project, load_test_file, collect_message, loaded) && first.render_page(loaded, "a.md", html);
+	check(rendered && html == generated["a.html"], "rendered page is the same as the generated one");
+
+	auto& used = *first.state;
+	auto& unused = *second.state;
+
+	check(!used.cache.blocks.empty() && unused.cache.blocks.empty(), "generators don't share the highlighting cache");
+	check(!used.snippets.snippets.empty() && unused.snippets.snippets.empty(), "generators don't share the snippet cache");
+	check(!used.directories.listings.empty() && unused.directories.listings.empty(), "generators don't share the directory cache");
+	check(!used.highlighted_languages.empty() && unused.highlighted_languages.empty(), "generators don't share the highlighting rules");
+
+	saved_pages.clear();
+	check(second.generate(project, load_test_file, save_test_page, collect_message) && saved_pages == generated, "second generator builds the same pages");
+}
+
+//Single pages rendered for previews while editing
+void test_preview()
+{
+	auto project = write_test_project("preview", R"("pages_order" : [ "a.md" ])", {
+		{ "a.md", "# A\n\n<!-- include snippets/note.md -->\n" },
+		{ "snippets/note.md", "Old note" }
+	});
+
+	litedocs::generator_settings settings;
+	settings.threads = 1;
+	settings.langs_directory = langs_directory;
+
+	litedocs::generator generator(settings);
+	litedocs::loaded_project loaded;
+
+	saved_pages.clear();
+	messages.clear();
+
+	check(generator.load_project(project, load_test_file, collect_message, loaded), "project loads for previews");
+
+	std::string html;
+	check(generator.render_page(loaded, "a.md", html) && html.find("Old note") != std::string::npos, "preview renders the page with its snippet");
+
+	std::ofstream(std::filesystem::path(project).parent_path() / "snippets" / "note.md", std::ios::binary) << "New note";
+
+	check(generator.render_page(loaded, "a.md", html) && html.find("New note") != std::string::npos, "preview reads changed snippets again");
+
+	std::string markdown = "# Draft\n\n```json\n{ \"a\" : 1 }\n```\n";
+	std::string stylesheet;
+
+	bool unsaved = generator.render_page(loaded, "draft.md", html, &markdown, &stylesheet);
+	check(unsaved && html.find("Draft") != std::string::npos && html.find("hl_json") != std::string::npos, "preview renders unsaved markdown of a page not in pages order");
+	check(stylesheet.find(".hl_json .c0") != std::string::npos, "preview gives the colors of the page's code blocks");
+
+	check(!generator.render_page(loaded, "missing.md", html), "preview of a missing page fails");
+	check(saved_pages.empty(), "previews save nothing");
+}
+
+/*
+	Worker pool and pipeline
+*/
+
+void test_task_exceptions()
+{
+	litedocs_internal::worker_pool pool(4);
+	litedocs_internal::worker_pool::task_group group;
+
+	for (size_t i = 0; i < 16; i++)
+		pool.submit(group, [i]() { if (i == 5) throw std::runtime_error("Failed on purpose"); });
+
+	bool rethrown = false;
+	try { pool.wait(group); }
+	catch (const std::runtime_error&) { rethrown = true; }
+
+	check(rethrown && group.pending == 0, "exception of a task is thrown from wait after the other tasks");
+
+	auto project = write_test_project("exceptions", R"("pages_order" : [ "a.md", "throws.md", "b.md" ])", {
+		{ "a.md", "# A" },
+		{ "throws.md", "# Throws" },
+		{ "b.md", "# B" }
+	});
+
+	for (size_t threads : { 1, 4 })
+	{
+		bool success = generate_test_project(project, threads);
+		check(!success && has_message("Failed on purpose"), "exception of a callback is reported with " + std::to_string(threads) + " threads");
+	}
+}
+
+/*
+	Batches
+*/
+
+void test_batch_results()
+{
+	auto good = write_test_project("batch_good", R"("pages_order" : [ "a.md" ])", { { "a.md", "# A" } });
+	auto failing = write_test_project("batch_failing", R"("pages_order" : [ "missing.md" ])", {});
+
+	litedocs::generator_settings settings;
+	settings.threads = 2;
+	settings.langs_directory = langs_directory;
+
+	litedocs::generator generator(settings);
+	std::vector<bool> succeeded;
+
+	saved_pages.clear();
+	messages.clear();
+
+	bool success = generator.generate_batch({ good, failing, "missing_project.json" }, load_test_file, save_test_page, collect_message, nullptr, &succeeded);
+
+	check(!success, "batch with a failing project fails");
+	check(succeeded == std::vector<bool>({ true, false, false }), "batch tells which projects failed");
+}
+
+/*
+	Assets
+*/
+
+std::set<std::string> saved_assets;
+
+void save_test_asset(const litedocs::staged_asset* asset, const std::string& project_path)
+{
+	std::lock_guard<std::mutex> lock(callbacks_mutex);
+	saved_assets.insert(asset->source);
+}
+
+void test_code_links()
+{
+	auto project = write_test_project("code_links", R"("pages_order" : [ "page.md" ])", {
+		{ "page.md", "![logo](logo.png)\n\n```html\n<img src=\"example.png\">\n```\n\nWrite <code>href=\"manual.pdf\"</code> for a download.\n" },
+		{ "logo.png", "png" },
+		{ "manual.pdf", "pdf" }
+	});
+
+	litedocs::generator_settings settings;
+	settings.threads = 1;
+	settings.langs_directory = langs_directory;
+
+	litedocs::generator generator(settings);
+
+	saved_pages.clear();
+	saved_assets.clear();
+	messages.clear();
+
+	check(generator.generate(project, load_test_file, save_test_page, collect_message, save_test_asset), "page with links in code builds");
+	check(saved_assets == std::set<std::string>({ "logo.png" }), "links in code are not assets");
+	check(!has_message("Missing asset"), "links in code are not reported as missing assets");
+}
+
+/*
+	Page tree
+*/
+
+void test_page_tree()
+{
+	litedocs_internal::project project;
+	auto pages = nlohmann::json::parse(R"([ "intro.md", "guide.md", [ "install.md", "usage.md", [ "advanced.md" ] ], "faq.md" ])");
+
+	check(litedocs_internal::recursive_get_pages_order(project.pages_order, pages, nullptr), "nested pages order is read");
+	litedocs_internal::build_page_tree(project);
+
+	auto& tree = project.tree;
+	const size_t none = litedocs_internal::page_tree::none;
+
+	std::vector<std::string> names;
+	for (size_t i = 0; i < tree.size(); i++)
+		names.push_back(project.pages_order.at(tree.node.at(i)).page_name);
+
+	check(names == std::vector<std::string>{ "intro", "guide", "install", "usage", "advanced", "faq" }, "tree has the pages in order");
+
+	bool linked = tree.previous.at(0) == none && tree.next.at(5) == none;
+	for (size_t i = 1; i < tree.size(); i++)
+		linked = linked && tree.previous.at(i) == i - 1 && tree.next.at(i - 1) == i;
+
+	check(linked, "previous and next follow pages order across sections");
+
+	check(tree.first_root == 0 && tree.next_sibling.at(0) == 1 && tree.next_sibling.at(1) == 5, "top pages are siblings");
+	check(tree.parent.at(2) == 1 && tree.parent.at(3) == 1 && tree.parent.at(4) == 3 && tree.parent.at(5) == none, "section pages are the pages before the nested arrays");
+	check(tree.first_child.at(1) == 2 && tree.next_sibling.at(2) == 3 && tree.first_child.at(3) == 4 && tree.first_child.at(5) == none, "sections list their pages");
+
+	bool sections = tree.sections.at(4).size() == 2 && *tree.sections.at(4).at(0) == "guide" && *tree.sections.at(4).at(1) == "usage" && tree.sections.at(5).empty();
+	check(sections, "pages get the names of the sections they are in");
+	check(tree.output_path.at(4) == "guide/usage/advanced" && tree.link.at(4) == "/guide/usage/advanced.html" && tree.link.at(5) == "/faq.html", "paths and links follow the sections");
+}
+
+/*
+	Directory entries of pages_order
+*/
+
+void test_expanded_directory()
+{
+	auto project = write_test_project("directory", R"("pages_order" : [ { "dir" : "api/" } ])", {
+		{ "api/intro.md", "# Intro" },
+		{ "api/net.md", "# Net" },
+		{ "api/net/http.md", "# Http" },
+		{ "api/net/tcp.md", "# Tcp" }
+	});
+
+	bool success = generate_test_project(project, 1);
+	check(success, "project with a directory entry builds");
+
+	check(saved_pages.count("api/net/http.html") == 1, "page of a nested directory is saved in its section's folder");
+	check(saved_pages.count("api/net/api/net/http.html") == 0, "page of a nested directory has no repeated path");
+
+	auto page = saved_pages.find("api/intro.html");
+	bool labeled = page != saved_pages.end()
+		&& page->second.find(">http<") != std::string::npos
+		&& page->second.find(">api/net/http<") == std::string::npos;
+
+	check(labeled, "page of a nested directory is labeled with its file name");
+
+	project = write_test_project("directory_index", R"("pages_order" : [ { "dir" : "api/" } ])", {
+		{ "api/guide/index.md", "# Guide" },
+		{ "api/guide/a.md", "# A" }
+	});
+
+	success = generate_test_project(project, 1);
+	check(success, "project with an index section page builds");
+
+	check(saved_pages.count("api/guide.html") == 1, "index section page is saved like its directory");
+	check(saved_pages.count("api/guide/a.html") == 1 && saved_pages.count("api/guide/index/a.html") == 0, "pages under an index section page are saved in its directory");
+
+	project = write_test_project("directory_missing", R"("pages_order" : [ "a.md", { "dir" : "missing/" } ])", {
+		{ "a.md", "# A" }
+	});
+
+	success = generate_test_project(project, 1);
+	check(!success && has_message("missing/"), "missing directory of pages order fails the project");
+}
+
+/*
+	Shards
+*/
+
+litedocs::loaded_file load_saved_test_page(std::string filename, const std::string& project_path)
+{
+	litedocs::loaded_file result;
+
+	std::lock_guard<std::mutex> lock(callbacks_mutex);
+
+	auto saved = saved_pages.find(filename);
+	if (saved == saved_pages.end()) return result;
+
+	result.content = saved->second;
+	result.success = true;
+
+	return result;
+}
+
+void test_shards()
+{
+	auto project = write_test_project("shards", R"("pages_order" : [ "a.md", { "dir" : "guide/" } ])", {
+		{ "a.md", "# A" },
+		{ "guide/first.md", "# First" },
+		{ "guide/second.md", "# Second" }
+	});
+
+	litedocs::generator_settings settings;
+	settings.threads = 2;
+	settings.langs_directory = langs_directory;
+
+	litedocs::generator generator(settings);
+
+	saved_pages.clear();
+	messages.clear();
+
+	std::string manifest;
+	bool invalid = generator.generate_shard(project, 2, 2, load_test_file, save_test_page, collect_message, manifest);
+	check(!invalid && has_message("Invalid shard 3/2"), "invalid shard is reported");
+	check(!generator.generate_shard(project, 0, 0, load_test_file, save_test_page, nullptr, manifest), "invalid shard fails without a message callback");
+
+	check(generator.generate_shard(project, 0, 1, load_test_file, save_test_page, collect_message, manifest), "only shard builds");
+	check(generator.merge_shards(project, { manifest }, load_test_file, save_test_page, collect_message, nullptr, load_saved_test_page), "merge checks the pages of the shard");
+
+	saved_pages["guide/first.html"] += "<!-- changed -->";
+	messages.clear();
+
+	bool changed = generator.merge_shards(project, { manifest }, load_test_file, save_test_page, collect_message, nullptr, load_saved_test_page);
+	check(!changed && has_message("guide/first.html"), "merge fails for a page changed since its shard");
+}
+
+/*
+	Archives
+*/
+
+bool has_archived(const litedocs::archive_reader& reader, const std::string& name, const std::string& content)
+{
+	size_t size = 0;
+	const char* data = reader.find(name, size);
+
+	return data != nullptr && std::string(data, size) == content;
+}
+
+void test_archive()
+{
+	auto folder = std::filesystem::temp_directory_path() / "litedocs_tests_archive";
+	std::filesystem::remove_all(folder);
+	std::filesystem::create_directories(folder);
+
+	std::string path = (folder / "build.tar").string();
+	std::string long_name = "guide/" + std::string(120, 'a') + ".html";
+
+	litedocs::archive_writer writer;
+	writer.open(path);
+
+	bool added = writer.add_file("index.html", "<p>Index</p>")
+		&& writer.add_file(long_name, [](std::ostream& out) { out << "<p>Long</p>"; })
+		&& writer.add_link("copy.html", "index.html")
+		&& writer.add_link("guide/" + std::string(120, 'b') + ".html", long_name);
+
+	check(added && writer.close(true), "archive is written with its index");
+
+	for (bool with_index : { true, false })
+	{
+		if (!with_index)
+			std::filesystem::remove(path + ".index");
+
+		std::string how = with_index ? " with the index" : " from the headers";
+
+		litedocs::archive_reader reader;
+		check(reader.open(path), "archive opens" + how);
+
+		check(has_archived(reader, "index.html", "<p>Index</p>"), "file is read back" + how);
+		check(has_archived(reader, long_name, "<p>Long</p>"), "file with a name over 100 bytes is read back" + how);
+		check(has_archived(reader, "copy.html", "<p>Index</p>"), "hard link is read back" + how);
+		check(has_archived(reader, "guide/" + std::string(120, 'b') + ".html", "<p>Long</p>"), "hard link with long names is read back" + how);
+		check(reader.names().size() == 4, "archive has no other entries" + how);
+	}
+
+	writer.open(path);
+	writer.add_file("index.html", "<p>Index</p>");
+
+	bool linked = writer.add_link("copy.html", "missing.html");
+	check(!linked && !writer.close(), "link to a missing file fails the archive");
+}
+
+/*
+	Split pages
+*/
+
+size_t count_occurrences(const std::string& text, const std::string& part)
+{
+	size_t count = 0;
+	for (size_t found = text.find(part); found != std::string::npos; found = text.find(part, found + 1))
+		count++;
+
+	return count;
+}
+
+bool has_balanced_divs(const std::string& html)
+{
+	return count_occurrences(html, "<div") == count_occurrences(html, "</div>");
+}
+
+void test_split_pages()
+{
+	std::string long_page;
+	for (int section = 1; section <= 6; section++)
+	{
+		long_page += "# Section " + std::to_string(section) + "\n\n";
+		for (int paragraph = 0; paragraph < 8; paragraph++)
+			long_page += "Paragraph of the section, long enough for the page to be split into a few parts.\n\n";
+	}
+
+	for (bool fragments : { false, true })
+	{
+		std::string settings = R"("pages_order" : [ "long.md" ], "split_threshold" : 1500, "fragments" : )";
+		settings += fragments ? "true" : "false";
+
+		auto project = write_test_project("split", settings, { { "long.md", long_page } });
+		std::string variant = fragments ? " with fragments" : "";
+
+		check(generate_test_project(project, 1), "split page builds" + variant);
+
+		auto page = saved_pages.find(fragments ? "long.fragment.html" : "long.html");
+		if (page == saved_pages.end())
+		{
+			check(false, "split page is saved" + variant);
+			continue;
+		}
+
+		const std::string& html = page->second;
+
+		size_t content = html.find("<div class=\"content\"");
+		size_t inner_begin = content == std::string::npos ? content : html.find('>', content) + 1;
+		size_t placeholders = html.find("<div class=\"split_parts\">");
+
+		check(placeholders != std::string::npos, "page over the threshold is split" + variant);
+		check(inner_begin < placeholders && html.find("Section 1", inner_begin) < placeholders, "first part stays in the page" + variant);
+		check(has_balanced_divs(html), "page has balanced divs" + variant);
+
+		size_t parts = 0;
+		bool parts_balanced = true;
+
+		for (auto& saved : saved_pages)
+		{
+			if (saved.first.find("long.part") != 0) continue;
+
+			parts++;
+			parts_balanced = parts_balanced && !saved.second.empty() && has_balanced_divs(saved.second);
+		}
+
+		check(parts > 0 && parts_balanced, "every part has balanced divs" + variant);
+	}
+}
+
+/*
+	Snippets
+*/
+
+void test_snippet_cache(litedocs_internal::generator_state& generator)
+{
+	auto& cache = generator.snippets;
+	size_t bytes_before = cache.bytes;
+
+	auto snippet = litedocs_internal::get_cached_snippet(generator, "# Install\n\nRun *the* installer, then **restart**.\n");
+	check(cache.bytes - bytes_before == snippet->markdown.size(), "snippet cache counts the markdown until converted");
+
+	std::set<std::string> languages;
+	auto previous_context = litedocs_internal::current_render_context;
+	litedocs_internal::current_render_context = { &generator, &languages, nullptr, nullptr, nullptr };
+
+	litedocs_internal::convert_snippet(generator, *snippet);
+
+	litedocs_internal::current_render_context = previous_context;
+
+	check(cache.bytes - bytes_before == snippet->html.size(), "snippet cache counts the html once converted");
+}
+
+/*
+	Highlighting
+*/
+
+void test_highlighting_classes(litedocs_internal::generator_state& generator)
+{
+	std::string code = "{ \"a\" : true, \"b\" : 1 }";
+	std::string highlighted = litedocs_internal::highlight_code(generator, "json", code, 0, code.size());
+
+	check(highlighted.rfind("<span class=\"hl_json\">", 0) == 0, "highlighted block has the class of its language");
+	check(highlighted.find("style=") == std::string::npos, "highlighted tokens have no inline styles");
+
+	//Keywords and numbers of the same color share a class
+	check(highlighted.find("<span class=\"c1\">true</span>") != std::string::npos && highlighted.find("<span class=\"c1\">1</span>") != std::string::npos,
+		"tokens of the same color get the same class");
+
+	std::string stylesheet;
+	litedocs_internal::generate_highlighting_stylesheet(generator, stylesheet, { "json" });
+
+	check(count_occurrences(stylesheet, ".hl_json .c") == 3 && stylesheet.find(".hl_json .c1 { color: #eb6734; }") != std::string::npos,
+		"stylesheet has a rule for every color of the language");
+}
+
+void test_regex_token_limit(litedocs_internal::generator_state& generator)
+{
+	std::string short_number = "12345";
+	std::string long_number(generator.settings.highlighting_regex_token_limit + 1, '7');
+
+	std::string short_highlighted = litedocs_internal::highlight_code(generator, "json", short_number, 0, short_number.size());
+	std::string long_highlighted = litedocs_internal::highlight_code(generator, "json", long_number, 0, long_number.size());
+
+	//The span of the block, and of the regex rule if it matched
+	check(count_occurrences(short_highlighted, "<span") == 2, "short token is matched by a regex rule");
+	check(count_occurrences(long_highlighted, "<span") == 1 && long_highlighted.find(long_number) != std::string::npos, "token over the limit is left plain");
+}
+
+//Pages with several code blocks, and text and code with the characters of the deferred blocks' placeholders
+void test_deferred_highlighting()
+{
+	auto project = write_test_project("deferred", R"("pages_order" : [ "a.md", "b.md" ])", {
+		{ "a.md", "# A\n\n```cpp\nint a = 0;\n```\n\n```json\n{ \"b\" : 1 }\n```\n\n```cpp\nreturn a < b && b > c;\n```\n" },
+		{ "b.md", "# B\n\nText with \x02" "0\x03 in it\n\n```\n\x02" "0\x03 plain\n```\n\n```json\n[ \"\x02" "1\x03\" ]\n```\n\n```json\n{ \"c\" : 2 }\n```\n" }
+	});
+
+	check(generate_test_project(project, 1), "project with code blocks builds highlighting in place");
+	auto in_place = saved_pages;
+
+	check(generate_test_project(project, 4), "project with code blocks builds with deferred highlighting");
+	check(saved_pages == in_place, "deferred highlighting gives the same pages as highlighting in place");
+}
+
+/*
+	Streaming
+*/
+
+//Html of the content div, converted whole or block by block
+std::string convert_content(litedocs_internal::generator_state& generator, const std::string& markdown, bool streamed)
+{
+	std::set<std::string> languages;
+
+	auto previous_context = litedocs_internal::current_render_context;
+	litedocs_internal::current_render_context = { &generator, &languages, nullptr, nullptr, nullptr };
+
+	std::string html;
+	litedocs_internal::string_output out{ html };
+	std::vector<std::string> links;
+
+	if (streamed)
+		litedocs_internal::generate_content_streamed(out, markdown, "", generator.html_tags, links, {});
+	else
+		litedocs_internal::generate_content(out, markdown, "", generator.html_tags, links, {});
+
+	litedocs_internal::current_render_context = previous_context;
+	return html;
+}
+
+void test_streamed_content(litedocs_internal::generator_state& generator)
+{
+	const std::string markdown =
+		"# Links\n"
+		"\n"
+		"Read [the guide][guide] first, then [Reference].\n"
+		"\n"
+		"    ```\n"
+		"    indented code, not a fence\n"
+		"\n"
+		"Paragraph after the indented code.\n"
+		"\n"
+		"<div class=\"note\">\n"
+		"\n"
+		"Inside of the html block\n"
+		"\n"
+		"</div>\n"
+		"\n"
+		"```cpp\n"
+		"int a = 0;\n"
+		"\n"
+		"int b = 1;\n"
+		"```\n"
+		"\n"
+		"Last paragraph, linking [the guide][guide] again.\n"
+		"\n"
+		"[guide]: https://example.com/guide\n"
+		"[reference]: https://example.com/reference\n";
+
+	check(convert_content(generator, markdown, true) == convert_content(generator, markdown, false), "streamed content is the same as converted at once");
+
+	std::vector<std::string> blocks;
+	litedocs_internal::for_each_markdown_block(markdown, [&](const std::string& block) { blocks.push_back(block); });
+
+	bool html_block_whole = false;
+	bool references_appended = false;
+	bool indented_fence_closed = false;
+
+	for (auto& block : blocks)
+	{
+		html_block_whole = html_block_whole || (block.find("<div") != std::string::npos && block.find("</div>") != std::string::npos);
+		references_appended = references_appended || (block.find("Read [the guide]") != std::string::npos && block.find("[reference]: ") != std::string::npos);
+		indented_fence_closed = indented_fence_closed || (block.find("indented code") != std::string::npos && block.find("Paragraph after") == std::string::npos);
+	}
+
+	check(blocks.size() > 1, "streamed content is split into blocks");
+	check(html_block_whole, "html block with empty lines stays in one block");
+	check(references_appended, "blocks get the reference definitions they use");
+	check(indented_fence_closed, "indented fence doesn't open a code block");
+}
+
+//Blocks a page is split into: fences and html blocks stay whole, definitions go to the blocks using them
+void test_markdown_blocks()
+{
+	const std::string fence = "```\ncode\n\n[fake]: https://example.com/fake\n```\n\n";
+	const std::string html_block = "<div>\n\nin html\n\n</div>\n\n";
+	const std::string definition = "[real]: https://example.com/real\n";
+
+	const std::string markdown = "# Title\n\n" + fence + "See [real] and [fake].\n\n" + html_block + "Last [REAL] use.\n\n" + definition;
+
+	std::vector<std::string> blocks;
+	litedocs_internal::for_each_markdown_block(markdown, [&](const std::string& block) { blocks.push_back(block); });
+
+	auto find_block = [&](const std::string& part) -> std::string
+	{
+		for (auto& block : blocks)
+			if (block.find(part) != std::string::npos)
+				return block;
+
+		return "";
+	};
+
+	check(find_block("```") == fence, "fenced code with an empty line is one block, and its definition-like line isn't a definition");
+	check(find_block("<div>") == html_block, "html block with empty lines is one block");
+
+	std::string first_use = find_block("See [real]");
+	check(first_use.find(definition) != std::string::npos && first_use.find("[fake]: ") == std::string::npos, "block gets the definitions it uses, not ones from code");
+	check(find_block("Last [REAL]").find(definition) != std::string::npos, "definitions are matched regardless of case");
+}
+
+int main(int argc, char* argv[])
+{
+	std::filesystem::path repository = argc > 1 ? argv[1] : ".";
+
+	litedocs::generator_settings settings;
+	settings.threads = 1;
+	settings.langs_directory = (repository / "langs").string();
+
+	langs_directory = settings.langs_directory;
+
+	litedocs_internal::generator_state generator(settings);
+
+	test_html_escaping();
+	test_generator_instances();
+	test_preview();
+	test_task_exceptions();
+	test_batch_results();
+	test_code_links();
+	test_page_tree();
+	test_expanded_directory();
+	test_split_pages();
+	test_shards();
+	test_archive();
+	test_snippet_cache(generator);
+	test_highlighting_classes(generator);
+	test_regex_token_limit(generator);
+	test_deferred_highlighting();
+	test_streamed_content(generator);
+	test_markdown_blocks();
+
+	std::cout << checks_count - failures_count << "/" << checks_count << " checks passed\n";
+	return failures_count == 0 ? 0 : 1;
+}